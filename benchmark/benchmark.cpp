@@ -0,0 +1,237 @@
+/*
+ * FogLAMP "rate" filter plugin.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <plugin_api.h>
+#include <filter_plugin.h>
+#include <config_category.h>
+#include <reading_set.h>
+#include <stream_generator.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/*
+ * Micro-benchmarks of the hot paths of the rate filter. Each benchmark
+ * drives the filter through the plugin interface with a synthetic
+ * stream, using a configuration that exercises one path, and reports
+ * the readings processed per second and the time per reading. The
+ * readings are generated before the time is measured, the time includes
+ * deleting the readings that leave the filter.
+ *
+ * Usage: rate_benchmark [-n readings] [benchmark ...]
+ */
+
+extern "C" {
+PLUGIN_INFORMATION *plugin_info();
+PLUGIN_HANDLE plugin_init(ConfigCategory *config, OUTPUT_HANDLE *outHandle, OUTPUT_STREAM output);
+void plugin_ingest(PLUGIN_HANDLE *handle, READINGSET *readingSet);
+void plugin_shutdown(PLUGIN_HANDLE *handle);
+};
+
+/**
+ * A benchmark, the configuration items that select the path measured
+ */
+typedef struct {
+	const char	*name;
+	const char	*trigger;
+	const char	*untrigger;
+	const char	*rate;
+	const char	*preTrigger;
+	bool		spikes;		// The stream contains spikes that trigger the filter
+} Benchmark;
+
+static const Benchmark benchmarks[] = {
+	// Averaging with a trigger that never fires
+	{ "untriggeredIngest",	"X > 1000", "X < 0.7", "1", "0", false },
+	// Every reading forwarded at full rate
+	{ "triggeredIngest",	"X > -1000", "X < -1000", "1", "0", false },
+	// A simple threshold trigger, no averaging or pretrigger buffering
+	{ "evaluate",		"X > 1000", "X < 0.7", "0", "0", false },
+	// A trigger that must be evaluated by exprtk
+	{ "evaluateExpression",	"sqrt(X * X) > 1000", "X < 0.7", "0", "0", false },
+	// Buffering of pretrigger data without averaging
+	{ "bufferPretrigger",	"X > 1000", "X < 0.7", "0", "1000", false },
+	// Triggering and untriggering, with averaging and pretrigger data
+	{ "transitions",	"X > 1.5", "X < 0.7", "1", "100", true }
+};
+
+/**
+ * The shape of the stream a benchmark is run with
+ */
+typedef struct {
+	int		datapoints;
+	int		assets;
+	size_t		batch;
+	long		triggerPeriod;
+} Stream;
+
+static unsigned long outputCount;
+
+/**
+ * The output stream of the filter, the next filter in the chain
+ * would take ownership of the readings so they are deleted here.
+ */
+static void output(OUTPUT_HANDLE *handle, READINGSET *readingSet)
+{
+	ReadingSet *set = (ReadingSet *)readingSet;
+	outputCount += set->getCount();
+	delete set;
+}
+
+/**
+ * The time now in nanoseconds
+ */
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * Run a benchmark and report the result
+ *
+ * @param benchmark	The benchmark to run
+ * @param stream	The shape of the stream
+ * @param count		The number of readings to process
+ */
+static void run(const Benchmark& benchmark, const Stream& stream, size_t count)
+{
+	// The plugin name in the default configuration is not quoted
+	string defaults = plugin_info()->config;
+	size_t pos = defaults.find("FILTER_NAME");
+	if (pos != string::npos)
+	{
+		defaults.replace(pos, strlen("FILTER_NAME"), "\"rate\"");
+	}
+	ConfigCategory config("rate", defaults);
+	config.setValue("enable", "true");
+	config.setValue("trigger", benchmark.trigger);
+	config.setValue("untrigger", benchmark.untrigger);
+	config.setValue("rate", benchmark.rate);
+	config.setValue("preTrigger", benchmark.preTrigger);
+
+	StreamGenerator generator(stream.assets, stream.datapoints,
+			benchmark.spikes ? stream.triggerPeriod : 0);
+	vector<ReadingSet *> sets;
+	for (size_t generated = 0; generated < count; generated += stream.batch)
+	{
+		vector<Reading *> readings;
+		generator.generate(readings, stream.batch);
+		sets.push_back(new ReadingSet(&readings));
+	}
+
+	PLUGIN_HANDLE handle = plugin_init(&config, NULL, output);
+	outputCount = 0;
+	double start = now();
+	for (auto it = sets.begin(); it != sets.end(); ++it)
+	{
+		plugin_ingest((PLUGIN_HANDLE *)handle, (READINGSET *)*it);
+	}
+	double elapsed = now() - start;
+	plugin_shutdown((PLUGIN_HANDLE *)handle);
+
+	size_t processed = sets.size() * stream.batch;
+	char trigger[32] = "-";
+	if (benchmark.spikes)
+	{
+		snprintf(trigger, sizeof(trigger), "%ld", stream.triggerPeriod);
+	}
+	printf("%-20s %10d %8d %8lu %8s %14.0f %12.1f %10lu\n", benchmark.name,
+			stream.datapoints, stream.assets, (unsigned long)stream.batch,
+			trigger, processed / (elapsed / 1e9), elapsed / processed,
+			outputCount);
+}
+
+int main(int argc, char **argv)
+{
+	size_t count = 100000;
+	vector<const char *> selected;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+		{
+			count = strtoul(argv[++i], NULL, 10);
+		}
+		else
+		{
+			selected.push_back(argv[i]);
+		}
+	}
+
+	/*
+	 * Each benchmark is run with a baseline stream and then with each
+	 * aspect of the stream varied in turn.
+	 */
+	const Stream baseline = { 4, 1, 100, 1000 };
+	vector<Stream> streams;
+	streams.push_back(baseline);
+	const int datapoints[] = { 1, 16, 64 };
+	for (size_t i = 0; i < sizeof(datapoints) / sizeof(datapoints[0]); i++)
+	{
+		Stream stream = baseline;
+		stream.datapoints = datapoints[i];
+		streams.push_back(stream);
+	}
+	const int assets[] = { 16, 1000 };
+	for (size_t i = 0; i < sizeof(assets) / sizeof(assets[0]); i++)
+	{
+		Stream stream = baseline;
+		stream.assets = assets[i];
+		streams.push_back(stream);
+	}
+	const size_t batches[] = { 1, 1000 };
+	for (size_t i = 0; i < sizeof(batches) / sizeof(batches[0]); i++)
+	{
+		Stream stream = baseline;
+		stream.batch = batches[i];
+		streams.push_back(stream);
+	}
+	const long periods[] = { 100, 10000 };
+	for (size_t i = 0; i < sizeof(periods) / sizeof(periods[0]); i++)
+	{
+		Stream stream = baseline;
+		stream.triggerPeriod = periods[i];
+		streams.push_back(stream);
+	}
+
+	printf("%-20s %10s %8s %8s %8s %14s %12s %10s\n", "benchmark", "datapoints",
+			"assets", "batch", "trigger", "readings/sec", "ns/reading", "output");
+	for (size_t b = 0; b < sizeof(benchmarks) / sizeof(benchmarks[0]); b++)
+	{
+		const Benchmark& benchmark = benchmarks[b];
+		bool run_benchmark = selected.empty();
+		for (auto it = selected.cbegin(); it != selected.cend(); ++it)
+		{
+			if (strcmp(*it, benchmark.name) == 0)
+			{
+				run_benchmark = true;
+			}
+		}
+		if (!run_benchmark)
+		{
+			continue;
+		}
+		for (auto it = streams.cbegin(); it != streams.cend(); ++it)
+		{
+			// The trigger period only matters if the stream has spikes
+			if (!benchmark.spikes && it->triggerPeriod != baseline.triggerPeriod)
+			{
+				continue;
+			}
+			run(benchmark, *it, count);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,30 @@
+#ifndef _ASSET_TRACKING_H
+#define _ASSET_TRACKING_H
+/*
+ * FogLAMP "rate" filter plugin.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <string>
+
+/**
+ * A stand-in for the FogLAMP AssetTracker, the tuples are counted
+ */
+class AssetTracker {
+	public:
+		static AssetTracker	*getAssetTracker();
+		void		addAssetTrackingTuple(std::string plugin,
+					std::string asset, std::string event)
+				{
+					m_tuples++;
+				};
+		unsigned long	getTupleCount() const { return m_tuples; };
+	private:
+		AssetTracker() : m_tuples(0) {};
+		unsigned long	m_tuples;
+};
+#endif
@@ -0,0 +1,42 @@
+#ifndef _CONFIG_CATEGORY_H
+#define _CONFIG_CATEGORY_H
+/*
+ * FogLAMP "rate" filter plugin.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <string>
+#include <vector>
+#include <rapidjson/document.h>
+
+/**
+ * A stand-in for the FogLAMP ConfigCategory. The category is created
+ * from the JSON of the default configuration of the plugin, the value
+ * of an item is its default unless a value is given.
+ */
+class ConfigCategory {
+	public:
+		ConfigCategory(const std::string& name, const std::string& json);
+		ConfigCategory() {};
+		const std::string&
+				getName() const { return m_name; };
+		bool		itemExists(const std::string& name) const;
+		std::string	getValue(const std::string& name) const;
+		void		setValue(const std::string& name, const std::string& value);
+	private:
+		/**
+		 * A configuration item and its value
+		 */
+		class CategoryItem {
+			public:
+				std::string	m_name;
+				std::string	m_value;
+		};
+		std::string			m_name;
+		std::vector<CategoryItem>	m_items;
+};
+#endif
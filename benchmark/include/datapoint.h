@@ -0,0 +1,84 @@
+#ifndef _DATAPOINT_H
+#define _DATAPOINT_H
+/*
+ * FogLAMP "rate" filter plugin.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <string>
+
+/**
+ * A stand-in for the FogLAMP DatapointValue, with the subset of the
+ * interface used by the filter. Only string, integer and floating
+ * point values are supported.
+ */
+class DatapointValue {
+	public:
+		typedef enum {
+			T_STRING,
+			T_INTEGER,
+			T_FLOAT
+		} dataTagType;
+		DatapointValue(const std::string& value) : m_type(T_STRING)
+		{
+			m_value.str = new std::string(value);
+		};
+		DatapointValue(const long value) : m_type(T_INTEGER)
+		{
+			m_value.i = value;
+		};
+		DatapointValue(const double value) : m_type(T_FLOAT)
+		{
+			m_value.f = value;
+		};
+		DatapointValue(const DatapointValue& obj) : m_type(obj.m_type)
+		{
+			if (m_type == T_STRING)
+				m_value.str = new std::string(*obj.m_value.str);
+			else
+				m_value = obj.m_value;
+		};
+		DatapointValue&	operator=(const DatapointValue& rhs);
+		~DatapointValue()
+		{
+			if (m_type == T_STRING)
+				delete m_value.str;
+		};
+		void		setValue(long value) { m_value.i = value; };
+		void		setValue(double value) { m_value.f = value; };
+		long		toInt() const { return m_value.i; };
+		double		toDouble() const { return m_value.f; };
+		std::string	toStringValue() const { return *m_value.str; };
+		dataTagType	getType() const { return m_type; };
+	private:
+		union {
+			std::string	*str;
+			long		i;
+			double		f;
+		} m_value;
+		dataTagType	m_type;
+};
+
+/**
+ * A stand-in for the FogLAMP Datapoint, a named value
+ */
+class Datapoint {
+	public:
+		Datapoint(const std::string& name, DatapointValue& value) :
+			m_name(name), m_value(value)
+		{
+		};
+		const std::string
+				getName() const { return m_name; };
+		const DatapointValue
+				getData() const { return m_value; };
+		DatapointValue&	getData() { return m_value; };
+	private:
+		std::string	m_name;
+		DatapointValue	m_value;
+};
+#endif
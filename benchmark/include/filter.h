@@ -0,0 +1,39 @@
+#ifndef _FILTER_H
+#define _FILTER_H
+/*
+ * FogLAMP "rate" filter plugin.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <string>
+#include <config_category.h>
+#include <filter_plugin.h>
+
+/**
+ * A stand-in for the FogLAMP filter base class
+ */
+class FogLampFilter {
+	public:
+		FogLampFilter(const std::string& filterName,
+			      ConfigCategory& filterConfig,
+			      OUTPUT_HANDLE *outHandle,
+			      OUTPUT_STREAM output);
+		~FogLampFilter() {};
+		const std::string&
+				getName() const { return m_name; };
+		bool		isEnabled() const { return m_enabled; };
+		ConfigCategory&	getConfig() { return m_config; };
+		void		setConfig(const std::string& newConfig);
+	public:
+		OUTPUT_HANDLE	*m_data;
+		OUTPUT_STREAM	m_func;
+	protected:
+		std::string	m_name;
+		ConfigCategory	m_config;
+		bool		m_enabled;
+};
+#endif
@@ -0,0 +1,22 @@
+#ifndef _FILTER_PLUGIN_H
+#define _FILTER_PLUGIN_H
+/*
+ * FogLAMP "rate" filter plugin.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <plugin_api.h>
+#include <reading_set.h>
+#include <asset_tracking.h>
+
+/**
+ * A stand-in for the FogLAMP filter plugin definitions
+ */
+typedef void READINGSET;
+typedef void OUTPUT_HANDLE;
+typedef void (*OUTPUT_STREAM)(OUTPUT_HANDLE *, READINGSET *);
+#endif
@@ -0,0 +1,26 @@
+#ifndef _LOGGER_H
+#define _LOGGER_H
+/*
+ * FogLAMP "rate" filter plugin.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <string>
+
+/**
+ * A stand-in for the FogLAMP Logger, messages are discarded
+ */
+class Logger {
+	public:
+		static Logger	*getLogger();
+		void		debug(const std::string& msg, ...) {};
+		void		info(const std::string& msg, ...) {};
+		void		warn(const std::string& msg, ...) {};
+		void		error(const std::string& msg, ...) {};
+		void		fatal(const std::string& msg, ...) {};
+};
+#endif
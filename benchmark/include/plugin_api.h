@@ -0,0 +1,30 @@
+#ifndef _PLUGIN_API
+#define _PLUGIN_API
+/*
+ * FogLAMP "rate" filter plugin.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+
+/**
+ * A stand-in for the FogLAMP plugin API definitions
+ */
+#define QUOTE(...) #__VA_ARGS__
+
+typedef struct {
+	const char	*name;
+	const char	*version;
+	unsigned int	options;
+	const char	*type;
+	const char	*interface;
+	const char	*config;
+} PLUGIN_INFORMATION;
+
+typedef void *PLUGIN_HANDLE;
+
+#define PLUGIN_TYPE_FILTER	"filter"
+#endif
@@ -0,0 +1,45 @@
+#ifndef _READING_H
+#define _READING_H
+/*
+ * FogLAMP "rate" filter plugin.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <datapoint.h>
+#include <string>
+#include <vector>
+#include <sys/time.h>
+
+/**
+ * A stand-in for the FogLAMP Reading, with the subset of the interface
+ * used by the filter.
+ */
+class Reading {
+	public:
+		Reading(const std::string& asset, Datapoint *value);
+		Reading(const std::string& asset, std::vector<Datapoint *> values);
+		Reading(const Reading& orig);
+		~Reading();
+		void		addDatapoint(Datapoint *value);
+		const std::string&
+				getAssetName() const { return m_asset; };
+		unsigned int	getDatapointCount() { return m_values.size(); };
+		const std::vector<Datapoint *>
+				getReadingData() const { return m_values; };
+		std::vector<Datapoint *>&
+				getReadingData() { return m_values; };
+		void		setTimestamp(struct timeval tm) { m_timestamp = tm; };
+		void		getTimestamp(struct timeval *tm) { *tm = m_timestamp; };
+		void		setUserTimestamp(struct timeval tm) { m_userTimestamp = tm; };
+		void		getUserTimestamp(struct timeval *tm) { *tm = m_userTimestamp; };
+	protected:
+		std::string			m_asset;
+		struct timeval			m_timestamp;
+		struct timeval			m_userTimestamp;
+		std::vector<Datapoint *>	m_values;
+};
+#endif
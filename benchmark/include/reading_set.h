@@ -0,0 +1,35 @@
+#ifndef _READINGSET_H
+#define _READINGSET_H
+/*
+ * FogLAMP "rate" filter plugin.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <reading.h>
+#include <vector>
+
+/**
+ * A stand-in for the FogLAMP ReadingSet. The reading set owns the
+ * readings it contains.
+ */
+class ReadingSet {
+	public:
+		ReadingSet();
+		ReadingSet(std::vector<Reading *>* readings);
+		virtual ~ReadingSet();
+		unsigned long	getCount() const { return m_count; };
+		const std::vector<Reading *>&
+				getAllReadings() const { return m_readings; };
+		std::vector<Reading *>*
+				getAllReadingsPtr() { return &m_readings; };
+		void		append(std::vector<Reading *>& readings);
+		void		clear();
+	protected:
+		unsigned long			m_count;
+		std::vector<Reading *>		m_readings;
+};
+#endif
@@ -0,0 +1,42 @@
+#ifndef _STREAM_GENERATOR_H
+#define _STREAM_GENERATOR_H
+/*
+ * FogLAMP "rate" filter plugin.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <reading.h>
+#include <string>
+#include <vector>
+
+/**
+ * A generator of a synthetic stream of readings for the benchmarks.
+ *
+ * The readings of the assets are interleaved, one reading every
+ * interval. Each reading has the given number of floating point
+ * datapoints, named X, D1, D2 and so on. The value of X varies between
+ * 0.4 and 0.6, except that once every trigger period readings of an
+ * asset it rises to 2.0 for the spike length readings. Hence "X > 1.5"
+ * triggers the filter and "X < 0.7" returns it to the untriggered state.
+ * A trigger period of zero gives a stream without spikes.
+ */
+class StreamGenerator {
+	public:
+		StreamGenerator(int assets, int datapoints, long triggerPeriod,
+				int spikeLength = 10, long interval = 1000);
+		void		generate(std::vector<Reading *>& readings, size_t count);
+	private:
+		std::vector<std::string>
+				m_assets;
+		std::vector<std::string>
+				m_names;
+		long		m_triggerPeriod;
+		int		m_spikeLength;
+		long		m_interval;
+		long		m_sequence;
+};
+#endif
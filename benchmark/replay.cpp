@@ -0,0 +1,658 @@
+/*
+ * FogLAMP "rate" filter plugin.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <plugin_api.h>
+#include <filter_plugin.h>
+#include <config_category.h>
+#include <reading_set.h>
+#include <rapidjson/document.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/*
+ * Replay a captured stream of readings through the rate filter. The
+ * readings are passed to plugin_ingest in batches and the readings
+ * output by the filter are written to a file in a canonical form, so
+ * that the output of two builds or two configurations of the filter
+ * may be compared with diff. Timing statistics of the ingest calls are
+ * written to stderr.
+ *
+ * Usage: rate_replay [options] input
+ *	-b batch	The number of readings passed in each ingest call, default 100
+ *	-c file		A JSON configuration category to apply
+ *	-s item=value	Set a configuration item, may be repeated
+ *	-o file		The file to write the output readings to, default stdout
+ *	-w file		Write the input readings to a binary capture file and exit
+ *
+ * The input is either a binary capture file, as written with -w, or a
+ * file with one reading in JSON per line. A JSON reading has the form
+ *
+ *	{"asset":"name","ts":"1546300800.000123","readings":{"X":1.5,"Y":3}}
+ *
+ * which is also the form of the output, or uses the FogLAMP names
+ * asset_code, user_ts and reading with user_ts of the form
+ * "2019-01-01 00:00:00.000123". Integer values are read as integers,
+ * other numbers as floating point values.
+ */
+
+extern "C" {
+PLUGIN_INFORMATION *plugin_info();
+PLUGIN_HANDLE plugin_init(ConfigCategory *config, OUTPUT_HANDLE *outHandle, OUTPUT_STREAM output);
+void plugin_ingest(PLUGIN_HANDLE *handle, READINGSET *readingSet);
+void plugin_shutdown(PLUGIN_HANDLE *handle);
+};
+
+#define CAPTURE_MAGIC	"RATECAP1"
+
+/**
+ * The types of a datapoint value in a capture file
+ */
+typedef enum {
+	CaptureString,
+	CaptureInteger,
+	CaptureFloat
+} CaptureType;
+
+static vector<Reading *>	produced;
+
+/**
+ * The output stream of the filter. The readings are taken from the
+ * reading set and written once the ingest call has been timed.
+ */
+static void output(OUTPUT_HANDLE *handle, READINGSET *readingSet)
+{
+	ReadingSet *set = (ReadingSet *)readingSet;
+	vector<Reading *> *readings = set->getAllReadingsPtr();
+	produced.insert(produced.end(), readings->begin(), readings->end());
+	set->clear();
+	delete set;
+}
+
+/**
+ * Parse a user timestamp, either seconds since the epoch or a date and
+ * time in UTC
+ *
+ * @param ts	The timestamp string
+ * @param tm	The parsed timestamp
+ * @return	False if the timestamp could not be parsed
+ */
+static bool parseTimestamp(const string& ts, struct timeval& tm)
+{
+	struct tm parts;
+	memset(&parts, 0, sizeof(parts));
+	const char *fraction = strptime(ts.c_str(), "%Y-%m-%d %H:%M:%S", &parts);
+	if (fraction)
+	{
+		tm.tv_sec = timegm(&parts);
+	}
+	else
+	{
+		char *end;
+		tm.tv_sec = strtol(ts.c_str(), &end, 10);
+		if (end == ts.c_str())
+		{
+			return false;
+		}
+		fraction = end;
+	}
+	tm.tv_usec = 0;
+	if (*fraction == '.')
+	{
+		// Take up to six digits of the fraction as microseconds
+		int digits = 0;
+		for (fraction++; isdigit(*fraction) && digits < 6; fraction++, digits++)
+		{
+			tm.tv_usec = tm.tv_usec * 10 + (*fraction - '0');
+		}
+		for (; digits < 6; digits++)
+		{
+			tm.tv_usec *= 10;
+		}
+	}
+	return true;
+}
+
+/**
+ * Create a reading from a line of JSON
+ *
+ * @param line	The line
+ * @return	The reading or NULL if the line is not a valid reading
+ */
+static Reading *parseReading(const string& line)
+{
+	rapidjson::Document doc;
+	doc.Parse(line.c_str());
+	if (doc.HasParseError() || !doc.IsObject())
+	{
+		return NULL;
+	}
+	const char *assetKey = doc.HasMember("asset") ? "asset" : "asset_code";
+	const char *tsKey = doc.HasMember("ts") ? "ts" : "user_ts";
+	const char *readingsKey = doc.HasMember("readings") ? "readings" : "reading";
+	if (!doc.HasMember(assetKey) || !doc[assetKey].IsString()
+		|| !doc.HasMember(tsKey) || !doc[tsKey].IsString()
+		|| !doc.HasMember(readingsKey) || !doc[readingsKey].IsObject())
+	{
+		return NULL;
+	}
+	struct timeval tm;
+	if (!parseTimestamp(doc[tsKey].GetString(), tm))
+	{
+		return NULL;
+	}
+	vector<Datapoint *> datapoints;
+	const rapidjson::Value& values = doc[readingsKey];
+	for (rapidjson::Value::ConstMemberIterator itr = values.MemberBegin();
+						itr != values.MemberEnd(); ++itr)
+	{
+		const rapidjson::Value& value = itr->value;
+		if (value.IsInt64())
+		{
+			DatapointValue dpv((long)value.GetInt64());
+			datapoints.push_back(new Datapoint(itr->name.GetString(), dpv));
+		}
+		else if (value.IsNumber())
+		{
+			DatapointValue dpv(value.GetDouble());
+			datapoints.push_back(new Datapoint(itr->name.GetString(), dpv));
+		}
+		else if (value.IsString())
+		{
+			DatapointValue dpv(string(value.GetString()));
+			datapoints.push_back(new Datapoint(itr->name.GetString(), dpv));
+		}
+	}
+	Reading *reading = new Reading(doc[assetKey].GetString(), datapoints);
+	reading->setUserTimestamp(tm);
+	reading->setTimestamp(tm);
+	return reading;
+}
+
+/**
+ * Read a string written to a capture file
+ */
+static bool readString(FILE *fp, string& str, size_t length)
+{
+	str.resize(length);
+	return length == 0 || fread(&str[0], 1, length, fp) == length;
+}
+
+/**
+ * Load the readings of a binary capture file
+ *
+ * @param fp		The capture file, positioned after the magic
+ * @param readings	The vector to append the readings to
+ * @return		False if the file is not a valid capture file
+ */
+static bool loadCapture(FILE *fp, vector<Reading *>& readings)
+{
+	uint16_t length;
+	while (fread(&length, sizeof(length), 1, fp) == 1)
+	{
+		string asset;
+		int64_t us;
+		uint16_t count;
+		if (!readString(fp, asset, length)
+			|| fread(&us, sizeof(us), 1, fp) != 1
+			|| fread(&count, sizeof(count), 1, fp) != 1)
+		{
+			return false;
+		}
+		vector<Datapoint *> datapoints;
+		for (uint16_t i = 0; i < count; i++)
+		{
+			string name;
+			uint8_t type;
+			if (fread(&length, sizeof(length), 1, fp) != 1
+				|| !readString(fp, name, length)
+				|| fread(&type, sizeof(type), 1, fp) != 1)
+			{
+				return false;
+			}
+			bool ok = true;
+			if (type == CaptureInteger)
+			{
+				int64_t value;
+				ok = fread(&value, sizeof(value), 1, fp) == 1;
+				DatapointValue dpv((long)value);
+				datapoints.push_back(new Datapoint(name, dpv));
+			}
+			else if (type == CaptureFloat)
+			{
+				double value;
+				ok = fread(&value, sizeof(value), 1, fp) == 1;
+				DatapointValue dpv(value);
+				datapoints.push_back(new Datapoint(name, dpv));
+			}
+			else
+			{
+				uint32_t size;
+				string value;
+				ok = fread(&size, sizeof(size), 1, fp) == 1 && readString(fp, value, size);
+				DatapointValue dpv(value);
+				datapoints.push_back(new Datapoint(name, dpv));
+			}
+			if (!ok)
+			{
+				return false;
+			}
+		}
+		Reading *reading = new Reading(asset, datapoints);
+		struct timeval tm;
+		tm.tv_sec = us / 1000000;
+		tm.tv_usec = us % 1000000;
+		reading->setUserTimestamp(tm);
+		reading->setTimestamp(tm);
+		readings.push_back(reading);
+	}
+	return true;
+}
+
+/**
+ * Load the readings of an input file, either a capture file or a file
+ * of readings in JSON
+ *
+ * @param path		The path of the file
+ * @param readings	The vector to append the readings to
+ * @return		False if the file could not be read
+ */
+static bool loadReadings(const char *path, vector<Reading *>& readings)
+{
+	FILE *fp = fopen(path, "rb");
+	if (!fp)
+	{
+		fprintf(stderr, "Unable to open %s\n", path);
+		return false;
+	}
+	char magic[sizeof(CAPTURE_MAGIC) - 1];
+	if (fread(magic, sizeof(magic), 1, fp) == 1 && memcmp(magic, CAPTURE_MAGIC, sizeof(magic)) == 0)
+	{
+		bool ok = loadCapture(fp, readings);
+		fclose(fp);
+		if (!ok)
+		{
+			fprintf(stderr, "%s is not a valid capture file\n", path);
+		}
+		return ok;
+	}
+	fclose(fp);
+
+	ifstream in(path);
+	string line;
+	unsigned long lineNo = 0;
+	while (getline(in, line))
+	{
+		lineNo++;
+		if (line.empty() || line[0] != '{')
+		{
+			continue;
+		}
+		Reading *reading = parseReading(line);
+		if (!reading)
+		{
+			fprintf(stderr, "%s:%lu: not a valid reading\n", path, lineNo);
+			return false;
+		}
+		readings.push_back(reading);
+	}
+	return true;
+}
+
+/**
+ * Write readings to a binary capture file
+ *
+ * @param path		The path of the capture file
+ * @param readings	The readings to write
+ * @return		False if the file could not be written
+ */
+static bool writeCapture(const char *path, const vector<Reading *>& readings)
+{
+	FILE *fp = fopen(path, "wb");
+	if (!fp)
+	{
+		fprintf(stderr, "Unable to create %s\n", path);
+		return false;
+	}
+	fwrite(CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC) - 1, 1, fp);
+	for (auto it = readings.cbegin(); it != readings.cend(); ++it)
+	{
+		const string& asset = (*it)->getAssetName();
+		uint16_t length = asset.size();
+		fwrite(&length, sizeof(length), 1, fp);
+		fwrite(asset.data(), 1, length, fp);
+		struct timeval tm;
+		(*it)->getUserTimestamp(&tm);
+		int64_t us = tm.tv_sec * 1000000LL + tm.tv_usec;
+		fwrite(&us, sizeof(us), 1, fp);
+		vector<Datapoint *>& datapoints = (*it)->getReadingData();
+		uint16_t count = datapoints.size();
+		fwrite(&count, sizeof(count), 1, fp);
+		for (auto dp = datapoints.begin(); dp != datapoints.end(); ++dp)
+		{
+			string name = (*dp)->getName();
+			length = name.size();
+			fwrite(&length, sizeof(length), 1, fp);
+			fwrite(name.data(), 1, length, fp);
+			DatapointValue& value = (*dp)->getData();
+			uint8_t type;
+			if (value.getType() == DatapointValue::T_INTEGER)
+			{
+				type = CaptureInteger;
+				int64_t i = value.toInt();
+				fwrite(&type, sizeof(type), 1, fp);
+				fwrite(&i, sizeof(i), 1, fp);
+			}
+			else if (value.getType() == DatapointValue::T_FLOAT)
+			{
+				type = CaptureFloat;
+				double f = value.toDouble();
+				fwrite(&type, sizeof(type), 1, fp);
+				fwrite(&f, sizeof(f), 1, fp);
+			}
+			else
+			{
+				type = CaptureString;
+				string s = value.toStringValue();
+				uint32_t size = s.size();
+				fwrite(&type, sizeof(type), 1, fp);
+				fwrite(&size, sizeof(size), 1, fp);
+				fwrite(s.data(), 1, size, fp);
+			}
+		}
+	}
+	return fclose(fp) == 0;
+}
+
+/**
+ * Append a string to a JSON document as a quoted JSON string
+ */
+static void quote(string& json, const string& str)
+{
+	json += '"';
+	for (auto c = str.cbegin(); c != str.cend(); ++c)
+	{
+		if (*c == '"' || *c == '\\')
+		{
+			json += '\\';
+			json += *c;
+		}
+		else if ((unsigned char)*c < 0x20)
+		{
+			char buf[8];
+			snprintf(buf, sizeof(buf), "\\u%04x", *c);
+			json += buf;
+		}
+		else
+		{
+			json += *c;
+		}
+	}
+	json += '"';
+}
+
+/**
+ * Write a reading in the canonical form, the datapoints in the order
+ * they appear in the reading and floating point values written with
+ * enough precision to be read back exactly.
+ *
+ * @param fp		The output file
+ * @param reading	The reading to write
+ */
+static void writeReading(FILE *fp, Reading *reading)
+{
+	struct timeval tm;
+	reading->getUserTimestamp(&tm);
+	char buf[64];
+	string json = "{\"asset\":";
+	quote(json, reading->getAssetName());
+	snprintf(buf, sizeof(buf), ",\"ts\":\"%ld.%06ld\",\"readings\":{",
+			(long)tm.tv_sec, (long)tm.tv_usec);
+	json += buf;
+	vector<Datapoint *>& datapoints = reading->getReadingData();
+	for (auto it = datapoints.begin(); it != datapoints.end(); ++it)
+	{
+		if (it != datapoints.begin())
+		{
+			json += ',';
+		}
+		quote(json, (*it)->getName());
+		json += ':';
+		DatapointValue& value = (*it)->getData();
+		if (value.getType() == DatapointValue::T_INTEGER)
+		{
+			snprintf(buf, sizeof(buf), "%ld", value.toInt());
+			json += buf;
+		}
+		else if (value.getType() == DatapointValue::T_FLOAT)
+		{
+			// Always include a decimal point so the value is read back as a float
+			snprintf(buf, sizeof(buf), "%.17g", value.toDouble());
+			json += buf;
+			if (strpbrk(buf, ".eEn") == NULL)
+			{
+				json += ".0";
+			}
+		}
+		else
+		{
+			quote(json, value.toStringValue());
+		}
+	}
+	json += "}}\n";
+	fputs(json.c_str(), fp);
+}
+
+/**
+ * Apply a JSON configuration category to the configuration
+ *
+ * @param config	The configuration
+ * @param path		The path of the JSON file
+ * @return		False if the file could not be read
+ */
+static bool loadConfig(ConfigCategory& config, const char *path)
+{
+	ifstream in(path);
+	if (!in)
+	{
+		fprintf(stderr, "Unable to open %s\n", path);
+		return false;
+	}
+	stringstream buf;
+	buf << in.rdbuf();
+	rapidjson::Document doc;
+	doc.Parse(buf.str().c_str());
+	if (doc.HasParseError() || !doc.IsObject())
+	{
+		fprintf(stderr, "%s is not a valid configuration category\n", path);
+		return false;
+	}
+	// The items are given as in a category, or as simple values
+	for (rapidjson::Value::ConstMemberIterator itr = doc.MemberBegin();
+						itr != doc.MemberEnd(); ++itr)
+	{
+		const rapidjson::Value& item = itr->value;
+		if (item.IsString())
+		{
+			config.setValue(itr->name.GetString(), item.GetString());
+		}
+		else if (item.IsObject() && item.HasMember("value") && item["value"].IsString())
+		{
+			config.setValue(itr->name.GetString(), item["value"].GetString());
+		}
+	}
+	return true;
+}
+
+/**
+ * The time now in nanoseconds
+ */
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void usage()
+{
+	fprintf(stderr, "Usage: rate_replay [-b batch] [-c config.json] [-s item=value]... "
+			"[-o output] [-w capture] input\n");
+}
+
+int main(int argc, char **argv)
+{
+	size_t batch = 100;
+	const char *outputPath = NULL;
+	const char *capturePath = NULL;
+	const char *inputPath = NULL;
+
+	// The plugin name in the default configuration is not quoted
+	string defaults = plugin_info()->config;
+	size_t pos = defaults.find("FILTER_NAME");
+	if (pos != string::npos)
+	{
+		defaults.replace(pos, strlen("FILTER_NAME"), "\"rate\"");
+	}
+	ConfigCategory config("rate", defaults);
+	config.setValue("enable", "true");
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+		{
+			batch = strtoul(argv[++i], NULL, 10);
+		}
+		else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+		{
+			if (!loadConfig(config, argv[++i]))
+			{
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+		{
+			string setting = argv[++i];
+			size_t equals = setting.find('=');
+			if (equals == string::npos)
+			{
+				usage();
+				return 1;
+			}
+			config.setValue(setting.substr(0, equals), setting.substr(equals + 1));
+		}
+		else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+		{
+			outputPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc)
+		{
+			capturePath = argv[++i];
+		}
+		else if (argv[i][0] != '-' && !inputPath)
+		{
+			inputPath = argv[i];
+		}
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+	if (!inputPath || batch == 0)
+	{
+		usage();
+		return 1;
+	}
+
+	vector<Reading *> readings;
+	if (!loadReadings(inputPath, readings))
+	{
+		return 1;
+	}
+	if (capturePath)
+	{
+		bool ok = writeCapture(capturePath, readings);
+		for (auto it = readings.begin(); it != readings.end(); ++it)
+		{
+			delete *it;
+		}
+		return ok ? 0 : 1;
+	}
+
+	FILE *out = outputPath ? fopen(outputPath, "w") : stdout;
+	if (!out)
+	{
+		fprintf(stderr, "Unable to create %s\n", outputPath);
+		return 1;
+	}
+
+	// Build the reading sets before the filter is timed
+	vector<ReadingSet *> sets;
+	for (size_t first = 0; first < readings.size(); first += batch)
+	{
+		vector<Reading *> slice(readings.begin() + first,
+				readings.begin() + min(first + batch, readings.size()));
+		sets.push_back(new ReadingSet(&slice));
+	}
+
+	PLUGIN_HANDLE handle = plugin_init(&config, NULL, output);
+	vector<double> times;
+	times.reserve(sets.size());
+	unsigned long producedCount = 0;
+	for (auto it = sets.begin(); it != sets.end(); ++it)
+	{
+		double start = now();
+		plugin_ingest((PLUGIN_HANDLE *)handle, (READINGSET *)*it);
+		times.push_back(now() - start);
+		for (auto r = produced.begin(); r != produced.end(); ++r)
+		{
+			writeReading(out, *r);
+			delete *r;
+		}
+		producedCount += produced.size();
+		produced.clear();
+	}
+	plugin_shutdown((PLUGIN_HANDLE *)handle);
+	if (outputPath)
+	{
+		fclose(out);
+	}
+
+	double total = 0.0;
+	for (auto it = times.cbegin(); it != times.cend(); ++it)
+	{
+		total += *it;
+	}
+	sort(times.begin(), times.end());
+	fprintf(stderr, "readings in       %lu\n", (unsigned long)readings.size());
+	fprintf(stderr, "readings out      %lu\n", producedCount);
+	fprintf(stderr, "ingest calls      %lu of %lu readings\n", (unsigned long)sets.size(),
+			(unsigned long)batch);
+	if (!times.empty())
+	{
+		fprintf(stderr, "ingest time       %.3f ms\n", total / 1e6);
+		fprintf(stderr, "readings/sec      %.0f\n", readings.size() / (total / 1e9));
+		fprintf(stderr, "ns/reading        %.1f\n", total / readings.size());
+		fprintf(stderr, "ingest call us    p50 %.1f  p99 %.1f  max %.1f\n",
+				times[times.size() / 2] / 1e3,
+				times[(times.size() * 99) / 100] / 1e3,
+				times.back() / 1e3);
+	}
+	return 0;
+}
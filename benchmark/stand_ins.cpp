@@ -0,0 +1,202 @@
+/*
+ * FogLAMP "rate" filter plugin.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <reading.h>
+#include <reading_set.h>
+#include <config_category.h>
+#include <logger.h>
+#include <filter.h>
+#include <asset_tracking.h>
+#include <rapidjson/document.h>
+
+using namespace std;
+
+/*
+ * The implementation of the stand-ins for the FogLAMP classes used by
+ * the filter. These do only what the filter and the benchmarks need.
+ */
+
+DatapointValue& DatapointValue::operator=(const DatapointValue& rhs)
+{
+	if (this == &rhs)
+	{
+		return *this;
+	}
+	if (m_type == T_STRING)
+	{
+		delete m_value.str;
+	}
+	m_type = rhs.m_type;
+	if (m_type == T_STRING)
+	{
+		m_value.str = new string(*rhs.m_value.str);
+	}
+	else
+	{
+		m_value = rhs.m_value;
+	}
+	return *this;
+}
+
+Reading::Reading(const string& asset, Datapoint *value) : m_asset(asset)
+{
+	m_values.push_back(value);
+	gettimeofday(&m_timestamp, NULL);
+	m_userTimestamp = m_timestamp;
+}
+
+Reading::Reading(const string& asset, vector<Datapoint *> values) : m_asset(asset),
+	m_values(values)
+{
+	gettimeofday(&m_timestamp, NULL);
+	m_userTimestamp = m_timestamp;
+}
+
+Reading::Reading(const Reading& orig) : m_asset(orig.m_asset),
+	m_timestamp(orig.m_timestamp), m_userTimestamp(orig.m_userTimestamp)
+{
+	for (auto it = orig.m_values.cbegin(); it != orig.m_values.cend(); ++it)
+	{
+		m_values.push_back(new Datapoint(**it));
+	}
+}
+
+Reading::~Reading()
+{
+	for (auto it = m_values.cbegin(); it != m_values.cend(); ++it)
+	{
+		delete *it;
+	}
+}
+
+void Reading::addDatapoint(Datapoint *value)
+{
+	m_values.push_back(value);
+}
+
+ReadingSet::ReadingSet() : m_count(0)
+{
+}
+
+ReadingSet::ReadingSet(vector<Reading *> *readings) : m_count(readings->size()),
+	m_readings(*readings)
+{
+}
+
+ReadingSet::~ReadingSet()
+{
+	for (auto it = m_readings.cbegin(); it != m_readings.cend(); ++it)
+	{
+		delete *it;
+	}
+}
+
+void ReadingSet::append(vector<Reading *>& readings)
+{
+	m_readings.insert(m_readings.end(), readings.begin(), readings.end());
+	m_count += readings.size();
+	readings.clear();
+}
+
+void ReadingSet::clear()
+{
+	m_readings.clear();
+	m_count = 0;
+}
+
+Logger *Logger::getLogger()
+{
+	static Logger logger;
+	return &logger;
+}
+
+ConfigCategory::ConfigCategory(const string& name, const string& json) : m_name(name)
+{
+	rapidjson::Document doc;
+	doc.Parse(json.c_str());
+	if (doc.HasParseError() || !doc.IsObject())
+	{
+		return;
+	}
+	for (rapidjson::Value::ConstMemberIterator itr = doc.MemberBegin();
+						itr != doc.MemberEnd(); ++itr)
+	{
+		CategoryItem item;
+		item.m_name = itr->name.GetString();
+		const rapidjson::Value& value = itr->value;
+		if (value.HasMember("value") && value["value"].IsString())
+		{
+			item.m_value = value["value"].GetString();
+		}
+		else if (value.HasMember("default") && value["default"].IsString())
+		{
+			item.m_value = value["default"].GetString();
+		}
+		m_items.push_back(item);
+	}
+}
+
+bool ConfigCategory::itemExists(const string& name) const
+{
+	for (auto it = m_items.cbegin(); it != m_items.cend(); ++it)
+	{
+		if (it->m_name.compare(name) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+string ConfigCategory::getValue(const string& name) const
+{
+	for (auto it = m_items.cbegin(); it != m_items.cend(); ++it)
+	{
+		if (it->m_name.compare(name) == 0)
+		{
+			return it->m_value;
+		}
+	}
+	return "";
+}
+
+void ConfigCategory::setValue(const string& name, const string& value)
+{
+	for (auto it = m_items.begin(); it != m_items.end(); ++it)
+	{
+		if (it->m_name.compare(name) == 0)
+		{
+			it->m_value = value;
+			return;
+		}
+	}
+	CategoryItem item;
+	item.m_name = name;
+	item.m_value = value;
+	m_items.push_back(item);
+}
+
+FogLampFilter::FogLampFilter(const string& filterName, ConfigCategory& filterConfig,
+		OUTPUT_HANDLE *outHandle, OUTPUT_STREAM output) :
+	m_data(outHandle), m_func(output), m_name(filterName), m_config(filterConfig)
+{
+	m_enabled = m_config.getValue("enable").compare("true") == 0;
+}
+
+void FogLampFilter::setConfig(const string& newConfig)
+{
+	m_config = ConfigCategory(m_name, newConfig);
+	m_enabled = m_config.getValue("enable").compare("true") == 0;
+}
+
+AssetTracker *AssetTracker::getAssetTracker()
+{
+	static AssetTracker tracker;
+	return &tracker;
+}
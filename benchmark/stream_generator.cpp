@@ -0,0 +1,68 @@
+/*
+ * FogLAMP "rate" filter plugin.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <stream_generator.h>
+#include <math.h>
+
+using namespace std;
+
+/**
+ * Construct a stream generator
+ *
+ * @param assets	The number of assets in the stream
+ * @param datapoints	The number of datapoints in each reading
+ * @param triggerPeriod	The number of readings of an asset between spikes, or zero
+ * @param spikeLength	The number of readings of an asset in each spike
+ * @param interval	The time between readings in microseconds
+ */
+StreamGenerator::StreamGenerator(int assets, int datapoints, long triggerPeriod,
+		int spikeLength, long interval) : m_triggerPeriod(triggerPeriod),
+	m_spikeLength(spikeLength), m_interval(interval), m_sequence(0)
+{
+	for (int i = 0; i < assets; i++)
+	{
+		m_assets.push_back("asset" + to_string(i));
+	}
+	m_names.push_back("X");
+	for (int i = 1; i < datapoints; i++)
+	{
+		m_names.push_back("D" + to_string(i));
+	}
+}
+
+/**
+ * Generate the next readings of the stream
+ *
+ * @param readings	The vector to append the readings to
+ * @param count		The number of readings to generate
+ */
+void StreamGenerator::generate(vector<Reading *>& readings, size_t count)
+{
+	for (size_t i = 0; i < count; i++, m_sequence++)
+	{
+		long asset = m_sequence % m_assets.size();
+		long n = m_sequence / m_assets.size();	// The sequence within the asset
+		bool spike = m_triggerPeriod > 0 && n % m_triggerPeriod >= m_triggerPeriod - m_spikeLength;
+		vector<Datapoint *> datapoints;
+		datapoints.reserve(m_names.size());
+		for (size_t d = 0; d < m_names.size(); d++)
+		{
+			DatapointValue value(spike && d == 0 ? 2.0 : 0.5 + 0.1 * sin(n * 0.01 + d));
+			datapoints.push_back(new Datapoint(m_names[d], value));
+		}
+		Reading *reading = new Reading(m_assets[asset], datapoints);
+		long us = m_sequence * m_interval;
+		struct timeval tm;
+		tm.tv_sec = 1000000000 + us / 1000000;
+		tm.tv_usec = us % 1000000;
+		reading->setUserTimestamp(tm);
+		reading->setTimestamp(tm);
+		readings.push_back(reading);
+	}
+}
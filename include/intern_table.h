@@ -0,0 +1,55 @@
+#ifndef _INTERN_TABLE_H
+#define _INTERN_TABLE_H
+/*
+ * FogLAMP "rate" filter plugin.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#define INTERN_NOT_FOUND	0xffffffff
+
+/**
+ * A table of interned names. Each distinct name is given a dense
+ * integer ID, allocated in the order the names are first interned,
+ * that may be used to index flat arrays of per name data.
+ *
+ * Lookups use an open addressing hash table with linear probing. Each
+ * slot holds the hash and ID of a name, so that a probe sequence only
+ * touches the names themselves when the hashes match.
+ */
+class InternTable {
+	public:
+		InternTable();
+		unsigned int		intern(const std::string& name);
+		unsigned int		find(const std::string& name) const;
+		const std::string&	name(unsigned int id) const
+					{
+						return m_names[id];
+					};
+		unsigned int		size() const
+					{
+						return m_names.size();
+					};
+		void			clear();
+	private:
+		struct Slot {
+			uint32_t	hash;
+			uint32_t	id;
+		};
+		static uint32_t		hash(const std::string& name);
+		unsigned int		probe(const std::string& name, uint32_t hash) const;
+		void			grow();
+		std::vector<std::string>
+					m_names;
+		std::vector<Slot>	m_slots;
+		uint32_t		m_mask;
+};
+
+#endif
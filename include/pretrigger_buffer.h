@@ -0,0 +1,184 @@
+#ifndef _PRETRIGGER_BUFFER_H
+#define _PRETRIGGER_BUFFER_H
+/*
+ * FogLAMP "rate" filter plugin.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <reading.h>
+#include <string>
+#include <vector>
+#include <sys/time.h>
+#include <intern_table.h>
+#include <timestamp.h>
+#include <spill_file.h>
+#include <atomic>
+#include <deque>
+#include <stdint.h>
+
+/**
+ * The memory budget shared by the pretrigger buffers of a filter. The
+ * buffers are grown in memory while the budget allows. The budget may
+ * be drawn on by several workers at once, each may exceed it by one
+ * growth of a buffer.
+ */
+class PretriggerBudget {
+	public:
+		PretriggerBudget() : m_limit(0), m_used(0) {};
+		bool		allows(size_t bytes) const;
+		void		charge(size_t bytes)
+				{
+					m_used.fetch_add(bytes, std::memory_order_relaxed);
+				};
+		void		release(size_t bytes)
+				{
+					m_used.fetch_sub(bytes, std::memory_order_relaxed);
+				};
+		void		setLimit(size_t limit)
+				{
+					m_limit.store(limit, std::memory_order_relaxed);
+				};
+	private:
+		std::atomic<size_t>	m_limit;
+		std::atomic<size_t>	m_used;
+};
+
+/**
+ * The pretrigger history of an asset, held as a ring buffer of rows
+ * with the timestamps and datapoint values stored in columns.
+ *
+ * Readings that contain only numeric datapoints are decomposed into
+ * the columns and the reading itself is freed. A reading object is
+ * only created again when the buffer is flushed as the result of a
+ * trigger. Readings that contain other datapoint types are held in
+ * the buffer as they are.
+ *
+ * The ring buffer is allocated when the first reading is added and
+ * grows to accommodate the number of readings in the pretrigger time,
+ * once grown there is no allocation when a reading
+ * is added to the buffer.
+ *
+ * If growing the ring buffer would exceed the memory budget, further
+ * readings are spilled to a memory mapped file until the spilled
+ * readings have expired or been flushed. The readings in the ring
+ * buffer are always older than those in the spill file.
+ *
+ * A reading copied to the buffer that has since been sent by other
+ * means may be marked to be skipped, it is then not sent again when
+ * the buffer is flushed. The rows of the buffer are numbered in the
+ * order they are added, a row to skip is identified by its number.
+ */
+class PretriggerBuffer {
+	public:
+		PretriggerBuffer(const std::string& asset, PretriggerBudget *budget = NULL);
+		~PretriggerBuffer();
+		void		append(Reading *reading, Timestamp tm);
+		void		appendCopy(Reading *reading, Timestamp tm);
+		unsigned int	expire(Timestamp limit);
+		void		skip(const Reading *reading);
+		void		flush(std::vector<Reading *>& out);
+		void		clear();
+		unsigned int	size() const
+				{
+					return m_count + spilled();
+				};
+		bool		empty() const
+				{
+					return size() == 0;
+				};
+		size_t		memory() const;
+		size_t		spillSize() const
+				{
+					return m_spill ? m_spill->size() : 0;
+				};
+	private:
+		/**
+		 * A stored datapoint value
+		 */
+		typedef union {
+			long	i;
+			double	f;
+		} Value;
+		/**
+		 * The layout of a reading, the columns that hold the
+		 * datapoints of the reading in the order the datapoints
+		 * appear in the reading.
+		 */
+		class Layout {
+			public:
+				bool		matches(const InternTable& names,
+						const std::vector<Datapoint *>& datapoints) const;
+				std::vector<unsigned int>
+						m_columns;
+				std::vector<bool>
+						m_integer;
+		};
+		/**
+		 * A reading spilled to the spill file, followed by the
+		 * values of the columns of its layout. A reading that
+		 * can not be stored in the columns is held as it is and
+		 * the spilled row points to it.
+		 */
+		struct SpilledRow {
+			Timestamp	userTimestamp;
+			struct timeval	timestamp;
+			int		layout;
+			Reading		*reading;
+		};
+		/**
+		 * The row that holds the copy of a reading
+		 */
+		struct Copy {
+			const Reading	*reading;
+			uint64_t	sequence;
+		};
+		unsigned int	spilled() const
+				{
+					return m_spill ? m_spill->count() : 0;
+				};
+		bool		spilling();
+		bool		spill(Reading *reading, Timestamp tm, bool owned);
+		void		unspill();
+		void		store(Reading *reading, Timestamp tm);
+		Reading		*materialize(const SpilledRow *row);
+		unsigned int	addRow(Reading *reading, Timestamp tm);
+		bool		storeColumns(unsigned int row, Reading *reading);
+		int		findLayout(const std::vector<Datapoint *>& datapoints);
+		unsigned int	grownCapacity() const;
+		void		grow();
+		size_t		rowSize() const;
+		Reading		*materialize(unsigned int row);
+		std::string	m_asset;
+		unsigned int	m_capacity;
+		unsigned int	m_mask;
+		unsigned int	m_head;
+		unsigned int	m_count;
+		std::vector<Timestamp>
+				m_userTimestamps;
+		std::vector<struct timeval>
+				m_timestamps;
+		std::vector<Reading *>
+				m_readings;
+		std::vector<unsigned short>
+				m_rowLayouts;
+		std::vector<std::vector<Value> >
+				m_columns;
+		InternTable	m_names;
+		std::vector<Layout>
+				m_layouts;
+		int		m_lastLayout;
+		PretriggerBudget
+				*m_budget;
+		SpillFile	*m_spill;
+		uint64_t	m_sequence;
+		std::deque<Copy>
+				m_copies;
+		std::vector<uint64_t>
+				m_skipped;
+};
+
+#endif
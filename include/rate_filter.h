@@ -14,12 +14,17 @@
 #include <config_category.h>
 #include <string>                 
 #include <logger.h>
-#include <list>
 #include <vector>
 #include <exprtk.hpp>
 #include <mutex>
-
-#define MAX_EXPRESSION_VARIABLES 40
+#include <atomic>
+#include <stdint.h>
+#include <intern_table.h>
+#include <pretrigger_buffer.h>
+#include <threshold_predicate.h>
+#include <reducer.h>
+#include <timestamp.h>
+#include <worker_pool.h>
 
 /**
  * A FogLAMP filter that allows variable rates of data to be sent.
@@ -33,9 +38,19 @@
  * expressions use the data points in the reading as variables
  * within the expression.
  *
- * TODO Currently the filter is limited to stream with a single
- * asset per stream. It should be enhanced to support multiple
- * assets.
+ * Each asset in the stream has its own trigger state, pretrigger
+ * buffer and averaging data, allowing a single filter to be used
+ * with streams that contain multiple assets.
+ *
+ * The filter counts the work it does and may send the counts as a
+ * statistics reading at a configured interval.
+ *
+ * The trigger may be debounced, held for a minimum time once set
+ * and held off for a time once cleared, to stop it flapping when
+ * the data is noisy.
+ *
+ * Large batches may be partitioned by asset into shards that are
+ * processed in parallel by a pool of worker threads.
  */
 class RateFilter : public FogLampFilter {
 	public:
@@ -44,66 +59,383 @@ class RateFilter : public FogLampFilter {
                         OUTPUT_HANDLE *outHandle,
                         OUTPUT_STREAM out);
 		~RateFilter();
-		void	setTrigger(const std::string& expression)
-			{
-				m_trigger = expression;
-			};
-		void	setUntrigger(const std::string& expression)
-			{
-				m_untrigger = expression;
-			};
-		void	setPreTrigger(int pretrigger)
-			{
-				m_pretrigger = pretrigger;
-			}
 		void	ingest(std::vector<Reading *> *readings, std::vector<Reading *>& out);
 		void	reconfigure(const std::string& newConfig);
 	private:
-		void	triggeredIngest(std::vector<Reading *> *readings, std::vector<Reading *>& out);
-		void	untriggeredIngest(std::vector<Reading *> *readings, std::vector<Reading *>& out);
-		void	sendPretrigger(std::vector<Reading *>& out);
-		void	sendPretrigger(std::vector<Reading *>& out, Reading *trigger);
-		void	bufferPretrigger(Reading *);
-		void	addAverageReading(Reading *, std::vector<Reading *>& out);
-		void	addDataPoint(const std::string&, double);
-		Reading *averageReading(Reading *);
-		void	clearAverage();
-		void 	handleConfig(const ConfigCategory& conf);
-		bool	isExcluded(const std::string& asset);
+		/**
+		 * The statistics that may be sent for each datapoint
+		 * in the reduced rate readings.
+		 */
+		typedef enum {
+			StatMean	= 0x01,
+			StatMin		= 0x02,
+			StatMax		= 0x04,
+			StatFirst	= 0x08,
+			StatLast	= 0x10,
+			StatCount	= 0x20,
+			StatVariance	= 0x40,
+			StatStddev	= 0x80
+		} Statistic;
+		/**
+		 * The mechanism used to reduce the rate of the readings
+		 * of an asset that is not triggered.
+		 */
+		typedef enum {
+			ReduceAverage,
+			ReduceMinMax,
+			ReduceLTTB,
+			ReduceDeadband,
+			ReduceSwingingDoor
+		} Reduction;
+		/**
+		 * The counts of the work done by the filter that are
+		 * sent in the statistics readings.
+		 */
+		typedef enum {
+			CountReadings,		// Readings ingested
+			CountForwarded,		// Readings sent at full rate
+			CountReduced,		// Readings passed to the reduction
+			CountDropped,		// Readings discarded unsent and unreduced
+			CountOutput,		// Readings output, including averages
+			CountTriggers,		// Transitions to the triggered state
+			CountUntriggers,	// Transitions to the untriggered state
+			CountEvaluations,	// Expression evaluations
+			CountEvaluateTime,	// Nanoseconds spent evaluating expressions
+			CountCompiles,		// Expression compilations
+			CountMax
+		} Count;
+		/**
+		 * The running totals of the counts. The ingest thread and
+		 * the workers count each batch in plain variables and add
+		 * them to the totals when the batch is done, reconfiguration adds
+		 * the compilations from its own thread. Relaxed atomic
+		 * operations suffice as the totals order nothing else.
+		 */
+		class Counters {
+			public:
+				Counters()
+				{
+					for (int i = 0; i < CountMax; i++)
+					{
+						m_totals[i] = 0;
+					}
+				};
+				void		add(Count count, uint64_t n)
+						{
+							m_totals[count].fetch_add(n, std::memory_order_relaxed);
+						};
+				uint64_t	total(Count count) const
+						{
+							return m_totals[count].load(std::memory_order_relaxed);
+						};
+			private:
+				std::atomic<uint64_t>	m_totals[CountMax];
+		};
+		/**
+		 * The running statistics of a datapoint over the current
+		 * reduced rate period. The variance is accumulated using
+		 * Welford's method.
+		 */
+		class Accumulator {
+			public:
+				Accumulator()
+				{
+					clear();
+				};
+				void		add(double value);
+				void		clear();
+				double		m_sum;
+				double		m_min;
+				double		m_max;
+				double		m_first;
+				double		m_last;
+				double		m_mean;
+				double		m_m2;
+				long		m_count;
+		};
+		/**
+		 * A datapoint of the average readings of an asset, the
+		 * statistic of an averaged datapoint and the name it is
+		 * sent with. The fields cache the names, the datapoints
+		 * themselves are created for each average reading.
+		 */
+		class Field {
+			public:
+				unsigned int	m_accumulator;
+				Statistic	m_statistic;
+				std::string	m_name;
+		};
+		/**
+		 * The values of the variables of an expression that are
+		 * taken from the readings of one asset. Variables that are
+		 * qualified by an asset name are shared by all assets and
+		 * are held by the expression itself.
+		 */
+		class Variables {
+			public:
+				Variables() : m_unassigned(-1) {};
+				void		clear()
+						{
+							m_values.clear();
+							m_assigned.clear();
+							m_unassigned = -1;
+						};
+				std::vector<double>	m_values;
+				std::vector<bool>	m_assigned;
+				int			m_unassigned;
+		};
+		/**
+		 * The per asset state of the filter. Each asset in the
+		 * stream is triggered independently and has its own
+		 * pretrigger buffer, averaging data and expression
+		 * variables.
+		 */
+		class AssetState {
+			public:
+				AssetState(unsigned int id, const std::string& asset,
+						PretriggerBudget *budget);
+				~AssetState();
+				unsigned int		m_id;
+				std::string		m_asset;
+				bool			m_excluded;
+				bool			m_state;
+				PretriggerBuffer	m_buffer;
+				Timestamp		m_lastSent;
+				Timestamp		m_periodStart;
+				Timestamp		m_windowClose;
+				Timestamp		m_earliestEnd;
+				Timestamp		m_armedAt;
+				unsigned int		m_matches;
+				int			m_averageCount;
+				InternTable		m_datapoints;
+				std::vector<Accumulator>
+							m_accumulators;
+				std::vector<Field>	m_fields;
+				size_t			m_fieldAccumulators;
+				unsigned int		m_fieldStatistics;
+				Reducer			*m_reducer;
+				Variables		m_triggerVariables;
+				Variables		m_untriggerVariables;
+		};
+		class Shard;
+		bool	endOfTrigger(Shard&, AssetState *, Reading *, Timestamp tm);
+		bool	debounce(AssetState *, bool matched);
+		AssetState
+			*getAssetState(const std::string& asset);
+		void	sendPretrigger(AssetState *, std::vector<Reading *>& out);
+		void	bufferPretrigger(Shard&, AssetState *, Reading *, Timestamp tm);
+		void	copyPretrigger(Shard&, AssetState *, Reading *, Timestamp tm);
+		void	expirePretrigger(Shard&, AssetState *, Timestamp now);
+		void	addAverageReading(AssetState *, Reading *, Timestamp tm,
+					std::vector<Reading *>& out);
+		void	addDataPoint(AssetState *, const std::string&, double);
+		Reading *averageReading(AssetState *, Timestamp timestamp);
+		void	buildFields(AssetState *);
+		void	clearAverage(AssetState *);
+		void	reduceReading(Shard&, AssetState *, Reading *, Timestamp tm,
+					std::vector<Reading *>& out);
+		void	expireSent(AssetState *, std::vector<Reading *>& out, size_t sent);
+		bool	endOfPeriod(AssetState *, Timestamp tm, Timestamp& stamp);
+		Timestamp
+			periodEnd(AssetState *);
+		void	flushPeriods(Timestamp now, std::vector<Reading *>& out);
+		class Evaluator;
+		bool	evaluate(Shard&, Evaluator *, Variables&, AssetState *, Reading *);
+		void	process(Shard&, const std::vector<Reading *>& readings,
+				std::vector<Reading *>& out);
+		bool	useWorkers(size_t count);
+		void	processShards(const std::vector<Reading *>& readings,
+				std::vector<Reading *>& out);
+		void	mergeShards(std::vector<Reading *>& out);
+		void	publishCounts(std::vector<Reading *>& out);
+		Reading *statisticsReading(Timestamp now);
 		class Evaluator {
 			public:
-				Evaluator(Reading *, const std::string& expression);
-				bool		evaluate(Reading *);
+				Evaluator(const std::string& expression);
+				bool		evaluate(Variables& variables, unsigned int assetId,
+							Reading *);
+				bool		isThreshold() const
+						{
+							return m_native;
+						};
+				bool		isQualified() const
+						{
+							return m_qualified;
+						};
+				size_t		evaluateBatch(const std::vector<Reading *>& readings,
+							const std::vector<AssetState *>& states,
+							std::vector<signed char>& results);
+				void		accept(size_t row, Variables& variables);
+				void		startBatch()
+						{
+							m_batch++;
+						};
 			private:
+				/**
+				 * The variable slots a datapoint is bound to, one
+				 * for the datapoint name and one for the asset
+				 * qualified datapoint name. A slot of -1 is used if
+				 * there is no such variable.
+				 */
+				struct Slots {
+					int		name;
+					int		qualified;
+				};
+				/**
+				 * The binding of the datapoints of an asset to the
+				 * variable slots, held in the order the datapoints
+				 * appear in the readings of the asset. The datapoints
+				 * last matched, and the batch they were matched in,
+				 * are also held.
+				 */
+				class Binding {
+					public:
+						Binding() : m_batch(0) {};
+						bool		matches(const std::vector<Datapoint *>& datapoints,
+								unsigned long batch);
+						std::vector<std::string>
+								m_names;
+						std::vector<Slots>
+								m_slots;
+						std::vector<const Datapoint *>
+								m_datapoints;
+						unsigned long	m_batch;
+				};
+				void		bind(Binding& binding, const std::string& asset,
+						     const std::vector<Datapoint *>& datapoints);
+				int		findVariable(const std::string& name) const;
+				static std::string
+						lower(const std::string& name);
+				void		bindThreshold();
+				void		prepare(Variables& variables);
+				void		store(Variables& variables, int slot, double value);
 				exprtk::expression<double>	m_expression;
 				exprtk::symbol_table<double>	m_symbolTable;
 				exprtk::parser<double>		m_parser;
-				double				m_variables[MAX_EXPRESSION_VARIABLES];
-				std::string			m_variableNames[MAX_EXPRESSION_VARIABLES];
-				int				m_varCount;
+				std::vector<double>		m_variables;
+				InternTable			m_variableNames;
+				std::vector<bool>		m_shared;
+				std::vector<int>		m_assetSlots;
+				std::vector<bool>		m_assigned;
+				int				m_unassigned;
 				std::string			m_expressionStr;
-				std::vector<std::string *>	m_assets;
+				std::vector<Binding>		m_bindings;
 				bool				m_compiled;
+				ThresholdPredicate		m_threshold;
+				bool				m_native;
+				bool				m_qualified;
+				std::vector<int>		m_slotColumns;
+				std::vector<int>		m_columnSlots;
+				std::vector<int>		m_termColumns;
+				std::vector<std::vector<double> >
+								m_columns;
+				std::vector<size_t>		m_columnRows;
+				std::vector<unsigned char>	m_known;
+				std::vector<unsigned char>	m_fired;
+				unsigned long			m_batch;
+		};
+		/**
+		 * A snapshot of the configuration of the filter. A new
+		 * snapshot is built when the filter is reconfigured and
+		 * is not changed once it has been handed to the ingest
+		 * thread, other than by the evaluators it owns.
+		 *
+		 * An evaluator may only be used by one thread at a time,
+		 * so if batches may be processed by the workers each
+		 * further worker has evaluators of its own. The first
+		 * worker uses the evaluators used for a whole batch.
+		 */
+		class Config {
+			public:
+				Config(const ConfigCategory& config);
+				~Config();
+				bool			isExcluded(const std::string& asset) const;
+				bool			isCompression() const
+							{
+								return m_reduction == ReduceDeadband
+									|| m_reduction == ReduceSwingingDoor;
+							};
+				void			parseStatistics(const std::string& json);
+				bool			isParallel() const
+							{
+								return !m_workerTriggers.empty();
+							};
+				void			compile(Evaluator *& trigger,
+							Evaluator *& untrigger);
+				std::string		m_trigger;
+				std::string		m_untrigger;
+				Timestamp		m_rate;
+				int			m_pretrigger;
+				Timestamp		m_fullTime;
+				bool			m_timeWindow;
+				InternTable		m_exclusions;
+				unsigned int		m_statistics;
+				Reduction		m_reduction;
+				std::string		m_reductionDatapoint;
+				double			m_deviation;
+				bool			m_alignPeriods;
+				Timestamp		m_statisticsInterval;
+				std::string		m_statisticsAsset;
+				unsigned int		m_workers;
+				size_t			m_pretriggerMemory;
+				unsigned int		m_debounce;
+				Timestamp		m_minimumDuration;
+				Timestamp		m_holdOff;
+				bool			m_retrigger;
+				Evaluator		*m_triggerExpression;
+				Evaluator		*m_untriggerExpression;
+				std::vector<Evaluator *>
+							m_workerTriggers;
+				std::vector<Evaluator *>
+							m_workerUntriggers;
+				unsigned int		m_compiles;
+		};
+		/**
+		 * The readings of a batch processed together, either the
+		 * whole batch or the readings of the assets assigned to
+		 * one worker, with the output and counts of the shard.
+		 *
+		 * A worker shard uses the evaluators of its worker and
+		 * notes the row in the batch of each of its readings, and
+		 * of the reading each output was produced by, so that the
+		 * outputs of the shards may be merged in the order the
+		 * whole batch would have produced them. The shard of a
+		 * whole batch uses the evaluators of the configuration.
+		 */
+		class Shard {
+			public:
+				Shard();
+				void			clear();
+				Evaluator		*m_trigger;
+				Evaluator		*m_untrigger;
+				std::vector<Reading *>	m_readings;
+				std::vector<size_t>	m_rows;
+				std::vector<AssetState *>
+							m_states;
+				std::vector<Timestamp>	m_times;
+				std::vector<signed char>
+							m_results;
+				std::vector<Reading *>	m_out;
+				std::vector<size_t>	m_outRows;
+				uint64_t		m_counts[CountMax];
+				uint64_t		m_evaluateCalls;
+				Timestamp		m_nextFlush;
 		};
-		std::string		m_trigger;
-		std::string		m_untrigger;
-		struct timeval		m_rate;
-		struct timeval		m_lastSent;
-		int			m_pretrigger;
-		struct timeval		m_fullTime;
-		struct timeval		m_windowClose;
-		bool			m_timeWindow;
-		std::list<Reading *>	m_buffer;
-		bool			m_state;
-		bool			m_pendingReconfigure;
+		Config			*m_current;
+		std::atomic<Config *>	m_pending;
 		std::mutex		m_configMutex;
-		Evaluator		*m_triggerExpression;
-		Evaluator		*m_untriggerExpression;
-		int			m_averageCount;
-		std::map<std::string, double>
-					m_averageMap;
-		std::vector<std::string>
-					m_exclusions;
+		PretriggerBudget	m_budget;
+		InternTable		m_assetNames;
+		std::vector<AssetState *>
+					m_assetStates;
+		Shard			m_batch;
+		std::vector<Shard *>	m_shards;
+		std::vector<size_t>	m_mergeNext;
+		WorkerPool		*m_pool;
+		Counters		m_counters;
+		uint64_t		m_reported[CountMax];
+		Timestamp		m_lastStatistics;
+		Timestamp		m_nextFlush;
 };
 
 
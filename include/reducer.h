@@ -0,0 +1,182 @@
+#ifndef _REDUCER_H
+#define _REDUCER_H
+/*
+ * FogLAMP "rate" filter plugin.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <reading.h>
+#include <intern_table.h>
+#include <timestamp.h>
+#include <string>
+#include <vector>
+
+/**
+ * A reduction engine that selects representative readings from the
+ * readings of an asset when it is not triggered, as an alternative to
+ * sending averages. The readings sent are the original readings.
+ *
+ * The readings are offered to the reducer one at a time, with their user
+ * timestamps, and the end of each reduced rate period is signalled by
+ * calling close. The reducer
+ * takes ownership of the readings it holds as candidates or sends.
+ *
+ * The reducer uses the values of the named datapoint, or if no name is
+ * given the first numeric datapoint of each reading.
+ */
+class Reducer {
+	public:
+		Reducer(const std::string& datapoint) : m_datapoint(datapoint) {};
+		virtual ~Reducer() {};
+		virtual bool	add(Reading *reading, Timestamp tm,
+					std::vector<Reading *>& out) = 0;
+		virtual void	close(std::vector<Reading *>& out) = 0;
+		virtual void	clear(std::vector<Reading *>& out) = 0;
+	protected:
+		bool		value(Reading *reading, double& value) const;
+		std::string	m_datapoint;
+};
+
+/**
+ * Send the readings with the minimum and maximum value in each period,
+ * in the order in which they were received.
+ */
+class MinMaxReducer : public Reducer {
+	public:
+		MinMaxReducer(const std::string& datapoint);
+		~MinMaxReducer();
+		bool		add(Reading *reading, Timestamp tm,
+					std::vector<Reading *>& out);
+		void		close(std::vector<Reading *>& out);
+		void		clear(std::vector<Reading *>& out);
+	private:
+		void		release(Reading *reading, Reading *other);
+		Reading		*m_min;
+		Reading		*m_max;
+		double		m_minValue;
+		double		m_maxValue;
+		Timestamp	m_minTime;
+		Timestamp	m_maxTime;
+};
+
+/**
+ * Send one reading per period chosen using the Largest Triangle Three
+ * Buckets algorithm. The reading chosen from a period is the one that
+ * forms the largest triangle with the reading chosen from the previous
+ * period and the mean of the following period, hence the readings of a
+ * period are held and sent one period later.
+ */
+class LTTBReducer : public Reducer {
+	public:
+		LTTBReducer(const std::string& datapoint);
+		~LTTBReducer();
+		bool		add(Reading *reading, Timestamp tm,
+					std::vector<Reading *>& out);
+		void		close(std::vector<Reading *>& out);
+		void		clear(std::vector<Reading *>& out);
+	private:
+		/**
+		 * The readings of a period and the points they represent
+		 */
+		class Bucket {
+			public:
+				void		clear();
+				std::vector<Reading *>
+						m_readings;
+				std::vector<Timestamp>
+						m_times;
+				std::vector<double>
+						m_values;
+		};
+		void		select(Timestamp time, double value, std::vector<Reading *>& out);
+		Bucket		m_current;
+		Bucket		m_previous;
+		bool		m_anchored;
+		Timestamp	m_anchorTime;
+		double		m_anchorValue;
+};
+
+/**
+ * The base of the compression reducers. These send a reading only when
+ * the values have changed significantly since the last reading sent.
+ * Each numeric datapoint is considered, unless a datapoint is named, and
+ * has its own incremental state.
+ *
+ * If no reading has been sent during a reduced rate period the latest
+ * reading is sent when the period closes, as a heartbeat.
+ */
+class CompressionReducer : public Reducer {
+	public:
+		CompressionReducer(const std::string& datapoint, double deviation);
+		~CompressionReducer();
+		void		close(std::vector<Reading *>& out);
+		void		clear(std::vector<Reading *>& out);
+	protected:
+		/**
+		 * The value of a monitored datapoint of a reading
+		 */
+		struct Point {
+			unsigned int	id;
+			double		value;
+		};
+		bool		points(Reading *reading, std::vector<Point>& points);
+		void		send(Reading *reading, std::vector<Reading *>& out);
+		void		hold(Reading *reading, Timestamp tm);
+		virtual void	archive(Timestamp time, const std::vector<Point>& points) = 0;
+		double		m_deviation;
+		InternTable	m_names;
+		bool		m_started;
+		bool		m_sent;
+		Reading		*m_held;
+		Timestamp	m_heldTime;
+		std::vector<Point>
+				m_points;
+};
+
+/**
+ * Send a reading when the value of a datapoint differs from the value
+ * last sent by more than the deviation.
+ */
+class DeadbandReducer : public CompressionReducer {
+	public:
+		DeadbandReducer(const std::string& datapoint, double deviation);
+		bool		add(Reading *reading, Timestamp tm,
+					std::vector<Reading *>& out);
+	private:
+		void		archive(Timestamp time, const std::vector<Point>& points);
+		std::vector<double>
+				m_last;
+};
+
+/**
+ * Swinging door compression. A reading is sent when the readings since
+ * the last reading sent can no longer be represented, to within the
+ * deviation, by a straight line from the last reading sent. The reading
+ * sent is the last that could be represented, hence the latest reading
+ * is held until the next reading has been seen.
+ */
+class SwingingDoorReducer : public CompressionReducer {
+	public:
+		SwingingDoorReducer(const std::string& datapoint, double deviation);
+		bool		add(Reading *reading, Timestamp tm,
+					std::vector<Reading *>& out);
+	private:
+		void		archive(Timestamp time, const std::vector<Point>& points);
+		void		open(unsigned int id, Timestamp time, double value);
+		std::vector<Timestamp>
+				m_archiveTimes;
+		std::vector<double>
+				m_archiveValues;
+		std::vector<double>
+				m_upper;
+		std::vector<double>
+				m_lower;
+		std::vector<Point>
+				m_heldPoints;
+};
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef _SPILL_FILE_H
+#define _SPILL_FILE_H
+/*
+ * FogLAMP "rate" filter plugin.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <stddef.h>
+
+/**
+ * A ring of variable length records held in a memory mapped file. The
+ * file is removed from the directory as soon as it is created, so it
+ * only lasts as long as it is open. The pages of the file may be written
+ * out and dropped from memory by the kernel, unlike anonymous memory.
+ *
+ * Records are added at the back of the ring and removed from the front,
+ * the file grows when the ring is full.
+ */
+class SpillFile {
+	public:
+		SpillFile();
+		~SpillFile();
+		void		*append(size_t length);
+		void		*front() const;
+		void		pop();
+		void		reset();
+		unsigned int	count() const
+				{
+					return m_count;
+				};
+		size_t		size() const
+				{
+					return m_size;
+				};
+	private:
+		bool		create();
+		bool		grow();
+		int		m_fd;
+		char		*m_base;
+		size_t		m_size;
+		size_t		m_head;
+		size_t		m_tail;
+		size_t		m_end;
+		bool		m_wrapped;
+		unsigned int	m_count;
+		bool		m_failed;
+};
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef _THRESHOLD_PREDICATE_H
+#define _THRESHOLD_PREDICATE_H
+/*
+ * FogLAMP "rate" filter plugin.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <string>
+#include <vector>
+
+/**
+ * A native implementation of simple threshold expressions. These are a
+ * comparison of a variable with a constant, or a conjunction of such
+ * comparisons, e.g. "X > 1.5" or "X < 0.2 and Y < 3".
+ *
+ * Expressions of this form are recognised when the trigger expressions
+ * are built and evaluated directly against the bound variable slots,
+ * other expressions are left to exprtk. Only the ordering comparisons are
+ * handled natively, these give the same result as the exprtk operators
+ * for all values including NaN.
+ */
+class ThresholdPredicate {
+	public:
+		typedef enum {
+			LessThan,
+			LessOrEqual,
+			GreaterThan,
+			GreaterOrEqual
+		} Operator;
+		/**
+		 * A single comparison of a variable with a constant
+		 */
+		class Term {
+			public:
+				std::string	m_variable;
+				Operator	m_operator;
+				double		m_value;
+				int		m_slot;
+		};
+		ThresholdPredicate() {};
+		bool		parse(const std::string& expression);
+		bool		evaluate(const double *variables) const;
+		void		evaluate(const double * const *columns, size_t rows,
+					 unsigned char *results) const;
+		std::vector<Term>
+				m_terms;
+	private:
+		bool		parseTerm(const std::string& expression, size_t& pos);
+		static bool	isReserved(const std::string& name);
+};
+
+#endif
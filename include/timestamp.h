@@ -0,0 +1,67 @@
+#ifndef _TIMESTAMP_H
+#define _TIMESTAMP_H
+/*
+ * FogLAMP "rate" filter plugin.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <reading.h>
+#include <stdint.h>
+#include <sys/time.h>
+
+/**
+ * The internal time base of the filter, a count of nanoseconds since
+ * the epoch. Times and periods are held in this form so that they may
+ * be added and compared as single integers.
+ */
+typedef int64_t Timestamp;
+
+#define NS_PER_SECOND	1000000000LL
+#define NS_PER_MS	1000000LL
+#define NS_PER_US	1000LL
+
+#define TIMESTAMP_MAX	INT64_MAX	// Later than any time
+
+/**
+ * Convert a timeval to a timestamp
+ *
+ * @param tm	The timeval
+ * @return	The timestamp
+ */
+inline Timestamp toTimestamp(const struct timeval& tm)
+{
+	return tm.tv_sec * NS_PER_SECOND + tm.tv_usec * NS_PER_US;
+}
+
+/**
+ * Convert a timestamp to a timeval, truncating to microseconds
+ *
+ * @param ts	The timestamp
+ * @return	The timeval
+ */
+inline struct timeval toTimeval(Timestamp ts)
+{
+	struct timeval tm;
+	tm.tv_sec = ts / NS_PER_SECOND;
+	tm.tv_usec = (ts % NS_PER_SECOND) / NS_PER_US;
+	return tm;
+}
+
+/**
+ * The user timestamp of a reading
+ *
+ * @param reading	The reading
+ * @return		The user timestamp of the reading
+ */
+inline Timestamp userTimestamp(Reading *reading)
+{
+	struct timeval tm;
+	reading->getUserTimestamp(&tm);
+	return toTimestamp(tm);
+}
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef _WORKER_POOL_H
+#define _WORKER_POOL_H
+/*
+ * FogLAMP "rate" filter plugin.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+
+/**
+ * A fixed pool of threads used to run a set of tasks in parallel. The
+ * thread that runs the tasks takes part in running them and returns
+ * once every task is done, hence a pool of n threads runs up to n + 1
+ * tasks at a time.
+ */
+class WorkerPool {
+	public:
+		WorkerPool(unsigned int threads);
+		~WorkerPool();
+		void		run(const std::function<void(unsigned int)>& task,
+				    unsigned int tasks);
+		unsigned int	threads() const
+				{
+					return m_threads.size();
+				};
+	private:
+		void		worker();
+		bool		next(unsigned int& task);
+		void		done();
+		std::vector<std::thread>
+				m_threads;
+		std::mutex	m_mutex;
+		std::condition_variable
+				m_started;
+		std::condition_variable
+				m_finished;
+		const std::function<void(unsigned int)>
+				*m_task;
+		unsigned int	m_tasks;
+		unsigned int	m_next;
+		unsigned int	m_pending;
+		unsigned long	m_generation;
+		bool		m_shutdown;
+};
+
+#endif
@@ -0,0 +1,138 @@
+/*
+ * FogLAMP "rate" filter plugin.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <intern_table.h>
+
+using namespace std;
+
+#define INITIAL_SLOTS	16
+
+/**
+ * Construct an empty intern table
+ */
+InternTable::InternTable()
+{
+	clear();
+}
+
+/**
+ * Return the ID of a name, adding the name to the table if it
+ * has not been seen before.
+ *
+ * @param name	The name to intern
+ * @return	The ID of the name
+ */
+unsigned int InternTable::intern(const string& name)
+{
+	uint32_t h = hash(name);
+	unsigned int slot = probe(name, h);
+	if (m_slots[slot].id != INTERN_NOT_FOUND)
+	{
+		return m_slots[slot].id;
+	}
+	unsigned int id = m_names.size();
+	m_names.push_back(name);
+	m_slots[slot].hash = h;
+	m_slots[slot].id = id;
+	// Keep the load factor below one half to keep probe sequences short
+	if (m_names.size() * 2 > m_slots.size())
+	{
+		grow();
+	}
+	return id;
+}
+
+/**
+ * Find the ID of a name without adding it to the table
+ *
+ * @param name	The name to find
+ * @return	The ID of the name or INTERN_NOT_FOUND
+ */
+unsigned int InternTable::find(const string& name) const
+{
+	return m_slots[probe(name, hash(name))].id;
+}
+
+/**
+ * Remove all the names from the table
+ */
+void InternTable::clear()
+{
+	Slot empty;
+	empty.hash = 0;
+	empty.id = INTERN_NOT_FOUND;
+	m_names.clear();
+	m_slots.assign(INITIAL_SLOTS, empty);
+	m_mask = INITIAL_SLOTS - 1;
+}
+
+/**
+ * The FNV-1a hash of a name
+ *
+ * @param name	The name to hash
+ * @return	The hash of the name
+ */
+uint32_t InternTable::hash(const string& name)
+{
+	uint32_t h = 2166136261U;
+	for (size_t i = 0; i < name.length(); i++)
+	{
+		h ^= (unsigned char)name[i];
+		h *= 16777619U;
+	}
+	return h;
+}
+
+/**
+ * Locate the slot that holds a name, or the empty slot at which the
+ * name would be inserted if it is not in the table.
+ *
+ * @param name	The name to locate
+ * @param h	The hash of the name
+ * @return	The index of the slot
+ */
+unsigned int InternTable::probe(const string& name, uint32_t h) const
+{
+	uint32_t slot = h & m_mask;
+	for (;;)
+	{
+		const Slot& s = m_slots[slot];
+		if (s.id == INTERN_NOT_FOUND ||
+			(s.hash == h && m_names[s.id].compare(name) == 0))
+		{
+			return slot;
+		}
+		slot = (slot + 1) & m_mask;
+	}
+}
+
+/**
+ * Double the number of slots in the table and rehash the names
+ */
+void InternTable::grow()
+{
+	Slot empty;
+	empty.hash = 0;
+	empty.id = INTERN_NOT_FOUND;
+	vector<Slot> slots(m_slots.size() * 2, empty);
+	m_mask = slots.size() - 1;
+	for (auto it = m_slots.cbegin(); it != m_slots.cend(); ++it)
+	{
+		if (it->id != INTERN_NOT_FOUND)
+		{
+			uint32_t slot = it->hash & m_mask;
+			while (slots[slot].id != INTERN_NOT_FOUND)
+			{
+				slot = (slot + 1) & m_mask;
+			}
+			slots[slot] = *it;
+		}
+	}
+	m_slots.swap(slots);
+}
@@ -15,6 +15,8 @@
 #include <strings.h>
 #include <string>
 #include <iostream>
+#include <unordered_set>
+#include <atomic>
 #include <filter_plugin.h>
 #include <rate_filter.h>
 #include <version.h>
@@ -93,6 +95,102 @@ const char *default_config = QUOTE({
 			"displayName" : "Exclusions",
 			"order" : "8",
 			"default" : "{ \"exclusions\" : [] }"
+			},
+		"statistics" : {
+			"description" : "The statistics to send for each datapoint at the reduced rate, any of mean, min, max, first, last, count, variance and stddev",
+			"type" : "JSON",
+			"displayName" : "Statistics",
+			"order" : "9",
+			"default" : "{ \"statistics\" : [ \"mean\" ] }"
+			},
+		"reduction": {
+			"description": "The mechanism used to reduce the rate of the data, averaging or sending selected readings",
+			"type": "enumeration",
+			"options" : [ "Average", "Min/Max", "LTTB", "Deadband", "Swinging Door" ],
+			"default": "Average",
+			"order" : "10",
+			"displayName" : "Reduction"
+			},
+		"reductionDatapoint": {
+			"description": "The datapoint used to select the readings to send, if blank the first numeric datapoint of each reading is used",
+			"type": "string",
+			"default": "",
+			"order" : "11",
+			"displayName" : "Reduction datapoint",
+			"validity" : "reduction != \"Average\""
+			},
+		"deviation": {
+			"description": "The change in value, or deviation from a straight line, that causes a reading to be sent by the Deadband and Swinging Door reductions",
+			"type": "float",
+			"default": "1.0",
+			"order" : "12",
+			"displayName" : "Compression deviation",
+			"validity" : "reduction == \"Deadband\" || reduction == \"Swinging Door\""
+			},
+		"alignPeriods": {
+			"description": "Align the reduced rate periods to the clock, e.g. to the start of each second or minute, rather than to the arrival of the readings",
+			"type": "boolean",
+			"default": "false",
+			"order" : "13",
+			"displayName" : "Align periods"
+			},
+		"statisticsInterval": {
+			"description": "The interval in seconds at which a reading of the filter statistics is sent, zero to send no statistics",
+			"type": "integer",
+			"default": "0",
+			"order" : "14",
+			"displayName" : "Statistics interval"
+			},
+		"statisticsAsset": {
+			"description": "The asset name of the filter statistics readings",
+			"type": "string",
+			"default": "rateStatistics",
+			"order" : "15",
+			"displayName" : "Statistics asset",
+			"validity" : "statisticsInterval != \"0\""
+			},
+		"workers": {
+			"description": "The number of threads used to process large batches of readings, the readings are shared between the threads by asset",
+			"type": "integer",
+			"default": "1",
+			"order" : "16",
+			"displayName" : "Workers"
+			},
+		"pretriggerMemory": {
+			"description": "The memory in kilobytes the pretrigger buffers may use, once used further pretrigger data is spilled to a file. Zero for no limit",
+			"type": "integer",
+			"default": "0",
+			"order" : "17",
+			"displayName" : "Pretrigger memory (KB)"
+			},
+		"debounce": {
+			"description": "The number of consecutive readings of an asset that must satisfy the trigger expression, or the end expression, before the trigger is set or cleared",
+			"type": "integer",
+			"default": "1",
+			"order" : "18",
+			"displayName" : "Debounce readings"
+			},
+		"minimumDuration": {
+			"description": "The minimum time the trigger remains set once it has been set, expressed in milliseconds",
+			"type": "integer",
+			"default": "0",
+			"order" : "19",
+			"displayName" : "Minimum full rate time (mS)"
+			},
+		"holdOff": {
+			"description": "The time after the trigger is cleared before it may be set again, expressed in milliseconds",
+			"type": "integer",
+			"default": "0",
+			"order" : "20",
+			"displayName" : "Re-arm hold off (mS)"
+			},
+		"retrigger": {
+			"description": "Restart the full rate time when the trigger expression is satisfied again while the trigger is set",
+			"type": "boolean",
+			"default": "false",
+			"order" : "21",
+			"displayName" : "Retrigger",
+			"validity" : "condition == \"Time\""
 			}
 	});
 
@@ -115,12 +213,55 @@ static PLUGIN_INFORMATION info = {
 	default_config	          // Default plugin configuration
 };
 
+/**
+ * The plugin instance. The asset names that have been reported to the
+ * asset tracker are remembered so that each is reported only once, the
+ * set is cleared when the filter is reconfigured. The output vector is
+ * kept between calls so that its storage is reused.
+ */
 typedef struct
 {
 	RateFilter	*handle;
 	std::string	configCatName;
+	std::unordered_set<std::string>
+			trackedAssets;
+	std::atomic<bool>
+			retrack;
+	std::vector<Reading *>
+			out;
 } FILTER_INFO;
 
+/**
+ * Report the assets of a set of readings to the asset tracker, if they
+ * have not already been reported. Readings of the same asset usually
+ * arrive together, so the set is only consulted when the asset changes.
+ *
+ * @param info		The plugin instance
+ * @param readings	The readings
+ */
+static void trackAssets(FILTER_INFO *info, const vector<Reading *>& readings)
+{
+	if (info->retrack.exchange(false))
+	{
+		info->trackedAssets.clear();
+	}
+	const string *last = NULL;
+	for (auto it = readings.cbegin(); it != readings.cend(); ++it)
+	{
+		const string& asset = (*it)->getAssetName();
+		if (last && asset.compare(*last) == 0)
+		{
+			continue;
+		}
+		last = &asset;
+		if (info->trackedAssets.insert(asset).second)
+		{
+			AssetTracker::getAssetTracker()->addAssetTrackingTuple(info->configCatName,
+							asset, string("Filter"));
+		}
+	}
+}
+
 /**
  * Return the information about this plugin
  */
@@ -149,6 +290,7 @@ PLUGIN_HANDLE plugin_init(ConfigCategory *config,
 					outHandle,
 					output);
 	info->configCatName = config->getName();
+	info->retrack = false;
 	
 	return (PLUGIN_HANDLE)info;
 }
@@ -175,39 +317,31 @@ void plugin_ingest(PLUGIN_HANDLE *handle,
 	}
 
 	/*
-	 * Create a new vector for the output readings. This may contain
-	 * a mixture of readings created by the plugin and readings from
-	 * the reading set passed in. The filter class takes care of
-	 * deleting any readings not passed up the chain.
+	 * The output readings may contain a mixture of readings created by
+	 * the plugin and readings from the reading set passed in. The filter
+	 * class takes care of deleting any readings not passed up the chain.
+	 *
+	 * The filter empties the vector of the reading set passed in, the
+	 * reading set and its storage are then reused to pass the output
+	 * readings up the chain. If the readings pass straight through the
+	 * filter, or some are removed, the storage is not reallocated.
 	 *
-	 * We create a new ReadingSet with the contains of the output
-	 * vector, hence the readingSet passed in is deleted.
+	 * The assets of the output readings are tracked, these include
+	 * the asset of the filter statistics readings.
 	 */
-	vector<Reading *> out;
-	filter->ingest(((ReadingSet *)readingSet)->getAllReadingsPtr(), out);
-	const vector<Reading *>& readings = ((ReadingSet *)readingSet)->getAllReadings();
-	for (vector<Reading *>::const_iterator elem = readings.begin();
-						      elem != readings.end();
-						      ++elem)
-	{
-		AssetTracker::getAssetTracker()->addAssetTrackingTuple(info->configCatName, (*elem)->getAssetName(), string("Filter"));
-	}
-	delete (ReadingSet *)readingSet;
+	ReadingSet *set = (ReadingSet *)readingSet;
+	vector<Reading *>& out = info->out;
+	filter->ingest(set->getAllReadingsPtr(), out);
+	trackAssets(info, out);
+	set->clear();
+	set->append(out);
+	out.clear();
 
 	/*
-	 * Create a new reading set and pass it up the filter
-	 * chain. Note this reading set may not contain any
-	 * actual readings.
+	 * Pass the reading set up the filter chain. Note this reading
+	 * set may not contain any actual readings.
 	 */
-	ReadingSet *newReadingSet = new ReadingSet(&out);
-	const vector<Reading *>& readings2 = newReadingSet->getAllReadings();
-	for (vector<Reading *>::const_iterator elem = readings2.begin();
-						      elem != readings2.end();
-						      ++elem)
-	{
-		AssetTracker::getAssetTracker()->addAssetTrackingTuple(info->configCatName, (*elem)->getAssetName(), string("Filter"));
-	}
-	filter->m_func(filter->m_data, newReadingSet);
+	filter->m_func(filter->m_data, set);
 }
 
 /**
@@ -221,6 +355,7 @@ void plugin_reconfigure(PLUGIN_HANDLE *handle, const string& newConfig)
 	FILTER_INFO *info = (FILTER_INFO *) handle;
 	RateFilter *filter = info->handle;
 	filter->reconfigure(newConfig);
+	info->retrack = true;
 }
 
 /**
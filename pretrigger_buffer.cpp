@@ -0,0 +1,657 @@
+/*
+ * FogLAMP "rate" filter plugin.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <pretrigger_buffer.h>
+#include <algorithm>
+
+using namespace std;
+
+#define INITIAL_CAPACITY	64	// Initial number of rows, must be a power of 2
+#define MAX_LAYOUTS		64	// Maximum number of distinct reading layouts
+
+/**
+ * Check if the budget allows more memory to be used
+ *
+ * @param bytes	The number of bytes
+ * @return	False if the memory would exceed the budget
+ */
+bool PretriggerBudget::allows(size_t bytes) const
+{
+	size_t limit = m_limit.load(memory_order_relaxed);
+	return limit == 0 || m_used.load(memory_order_relaxed) + bytes <= limit;
+}
+
+/**
+ * Construct an empty pretrigger buffer. The storage of the ring buffer
+ * is not allocated until the first reading is added, most assets are
+ * never buffered if the pretrigger time is zero.
+ *
+ * @param asset		The asset name of the readings in the buffer
+ * @param budget	The memory budget the buffer draws on, or NULL
+ *			for no budget
+ */
+PretriggerBuffer::PretriggerBuffer(const string& asset, PretriggerBudget *budget) :
+	m_asset(asset), m_capacity(0), m_mask(0),
+	m_head(0), m_count(0), m_lastLayout(-1), m_budget(budget), m_spill(NULL),
+	m_sequence(0)
+{
+}
+
+/**
+ * Destroy the buffer and any readings held in it
+ */
+PretriggerBuffer::~PretriggerBuffer()
+{
+	clear();
+	if (m_budget)
+	{
+		m_budget->release(memory());
+	}
+	delete m_spill;
+}
+
+/**
+ * Add a reading to the end of the buffer. The buffer takes ownership of
+ * the reading.
+ *
+ * @param reading	The reading to add
+ * @param tm		The user timestamp of the reading
+ */
+void PretriggerBuffer::append(Reading *reading, Timestamp tm)
+{
+	if (spilling() && spill(reading, tm, true))
+	{
+		return;
+	}
+	store(reading, tm);
+}
+
+/**
+ * Add a reading to the end of the ring buffer, taking ownership of the
+ * reading
+ *
+ * @param reading	The reading to add
+ * @param tm		The user timestamp of the reading
+ */
+void PretriggerBuffer::store(Reading *reading, Timestamp tm)
+{
+	unsigned int row = addRow(reading, tm);
+	if (storeColumns(row, reading))
+	{
+		delete reading;
+	}
+	else
+	{
+		// Not a reading we can store in the columns, keep it as it is
+		m_readings[row] = reading;
+	}
+}
+
+/**
+ * Add a copy of a reading to the end of the buffer. The caller retains
+ * ownership of the reading, a reading that can be stored in the columns
+ * is stored without creating a copy of the reading object. The row is
+ * remembered as the copy of the reading so that it may later be skipped.
+ *
+ * @param reading	The reading to add
+ * @param tm		The user timestamp of the reading
+ */
+void PretriggerBuffer::appendCopy(Reading *reading, Timestamp tm)
+{
+	Copy copy;
+	copy.reading = reading;
+	copy.sequence = m_sequence + size();
+	m_copies.push_back(copy);
+	if (spilling() && spill(reading, tm, false))
+	{
+		return;
+	}
+	unsigned int row = addRow(reading, tm);
+	if (!storeColumns(row, reading))
+	{
+		m_readings[row] = new Reading(*reading);
+	}
+}
+
+/**
+ * Check if a reading should be added to the spill file rather than the
+ * ring buffer. Once readings have been spilled the following readings
+ * are also spilled, to keep the readings in order, otherwise readings
+ * are spilled if the ring buffer is full and the memory budget does not
+ * allow it to grow.
+ *
+ * @return	True if the reading should be spilled
+ */
+bool PretriggerBuffer::spilling()
+{
+	if (spilled() > 0)
+	{
+		return true;
+	}
+	return m_count == m_capacity && m_budget
+		&& !m_budget->allows((grownCapacity() - m_capacity) * rowSize());
+}
+
+/**
+ * Add a reading to the spill file
+ *
+ * @param reading	The reading
+ * @param tm		The user timestamp of the reading
+ * @param owned		True if the buffer takes ownership of the reading
+ * @return		False if the spill file could not be written, the
+ *			reading must then be added to the ring buffer
+ */
+bool PretriggerBuffer::spill(Reading *reading, Timestamp tm, bool owned)
+{
+	if (m_spill == NULL)
+	{
+		m_spill = new SpillFile();
+	}
+	const vector<Datapoint *>& datapoints = reading->getReadingData();
+	int layout = findLayout(datapoints);
+	size_t values = layout == -1 ? 0 : datapoints.size();
+	SpilledRow *row = (SpilledRow *)m_spill->append(sizeof(SpilledRow) + values * sizeof(Value));
+	if (row == NULL)
+	{
+		// The ring buffer is grown beyond the budget instead
+		unspill();
+		return false;
+	}
+	row->userTimestamp = tm;
+	reading->getTimestamp(&row->timestamp);
+	row->layout = layout;
+	if (layout == -1)
+	{
+		row->reading = owned ? reading : new Reading(*reading);
+		return true;
+	}
+	row->reading = NULL;
+	Value *value = (Value *)(row + 1);
+	const Layout& l = m_layouts[layout];
+	for (size_t i = 0; i < datapoints.size(); i++)
+	{
+		DatapointValue& dpvalue = datapoints[i]->getData();
+		if (l.m_integer[i])
+		{
+			value[i].i = dpvalue.toInt();
+		}
+		else
+		{
+			value[i].f = dpvalue.toDouble();
+		}
+	}
+	if (owned)
+	{
+		delete reading;
+	}
+	return true;
+}
+
+/**
+ * Move the spilled readings to the end of the ring buffer, growing the
+ * ring buffer regardless of the memory budget. Used if the spill file
+ * can not be written.
+ */
+void PretriggerBuffer::unspill()
+{
+	while (spilled() > 0)
+	{
+		SpilledRow *row = (SpilledRow *)m_spill->front();
+		Reading *reading = row->reading ? row->reading : materialize(row);
+		Timestamp tm = row->userTimestamp;
+		m_spill->pop();
+		store(reading, tm);
+	}
+}
+
+/**
+ * Add a row to the end of the buffer for a reading and store the
+ * timestamps of the reading
+ *
+ * @param reading	The reading the row is for
+ * @param tm		The user timestamp of the reading
+ * @return		The row
+ */
+unsigned int PretriggerBuffer::addRow(Reading *reading, Timestamp tm)
+{
+	if (m_count == m_capacity)
+	{
+		grow();
+	}
+	unsigned int row = (m_head + m_count) & m_mask;
+	m_userTimestamps[row] = tm;
+	reading->getTimestamp(&m_timestamps[row]);
+	m_count++;
+	return row;
+}
+
+/**
+ * Store the datapoint values of a reading in the columns
+ *
+ * @param row		The row to store the values in
+ * @param reading	The reading
+ * @return		False if the reading can not be stored in the columns
+ */
+bool PretriggerBuffer::storeColumns(unsigned int row, Reading *reading)
+{
+	const vector<Datapoint *>& datapoints = reading->getReadingData();
+	int layout = findLayout(datapoints);
+	if (layout == -1)
+	{
+		return false;
+	}
+	m_readings[row] = NULL;
+	m_rowLayouts[row] = layout;
+	const Layout& l = m_layouts[layout];
+	for (size_t i = 0; i < datapoints.size(); i++)
+	{
+		DatapointValue& dpvalue = datapoints[i]->getData();
+		Value& value = m_columns[l.m_columns[i]][row];
+		if (l.m_integer[i])
+		{
+			value.i = dpvalue.toInt();
+		}
+		else
+		{
+			value.f = dpvalue.toDouble();
+		}
+	}
+	return true;
+}
+
+/**
+ * Remove the readings from the front of the buffer that have a user
+ * timestamp earlier than the limit given.
+ *
+ * @param limit	The timestamp of the oldest reading to keep
+ * @return	The number of readings removed
+ */
+unsigned int PretriggerBuffer::expire(Timestamp limit)
+{
+	unsigned int expired = 0;
+	while (m_count > 0 && m_userTimestamps[m_head] < limit)
+	{
+		delete m_readings[m_head];
+		m_readings[m_head] = NULL;
+		m_head = (m_head + 1) & m_mask;
+		m_count--;
+		expired++;
+	}
+	// The spilled readings follow those in the ring buffer
+	while (m_count == 0 && spilled() > 0)
+	{
+		SpilledRow *row = (SpilledRow *)m_spill->front();
+		if (row->userTimestamp >= limit)
+		{
+			break;
+		}
+		delete row->reading;
+		m_spill->pop();
+		expired++;
+	}
+	m_sequence += expired;
+	// Forget the copies and skipped rows that are no longer in the buffer
+	while (!m_copies.empty() && m_copies.front().sequence < m_sequence)
+	{
+		m_copies.pop_front();
+	}
+	for (size_t i = 0; i < m_skipped.size(); )
+	{
+		if (m_skipped[i] < m_sequence)
+		{
+			m_skipped[i] = m_skipped.back();
+			m_skipped.pop_back();
+		}
+		else
+		{
+			i++;
+		}
+	}
+	return expired;
+}
+
+/**
+ * Mark the row holding the copy of a reading to be skipped when the
+ * buffer is flushed, as the reading has already been sent.
+ *
+ * The reading is identified by its address. An address may be reused
+ * once the reading it held has been freed, but the reading is still
+ * alive when it is sent, so the latest copy made from that address is
+ * the copy of this reading.
+ *
+ * @param reading	The reading that has been sent
+ */
+void PretriggerBuffer::skip(const Reading *reading)
+{
+	for (auto it = m_copies.crbegin(); it != m_copies.crend(); ++it)
+	{
+		if (it->reading == reading)
+		{
+			m_skipped.push_back(it->sequence);
+			return;
+		}
+	}
+}
+
+/**
+ * Append the readings in the buffer to the output vector, creating
+ * readings for those held in the columns or the spill file, and empty
+ * the buffer. The readings marked to be skipped are discarded.
+ *
+ * @param out	The vector to append the readings to
+ */
+void PretriggerBuffer::flush(vector<Reading *>& out)
+{
+	// Rows are flushed in sequence order, as are the rows to skip
+	sort(m_skipped.begin(), m_skipped.end());
+	m_skipped.erase(unique(m_skipped.begin(), m_skipped.end()), m_skipped.end());
+	auto skip = m_skipped.cbegin();
+	for (unsigned int i = 0; i < m_count; i++)
+	{
+		unsigned int row = (m_head + i) & m_mask;
+		if (skip != m_skipped.cend() && *skip == m_sequence)
+		{
+			skip++;
+			delete m_readings[row];
+			m_readings[row] = NULL;
+		}
+		else if (m_readings[row])
+		{
+			out.push_back(m_readings[row]);
+			m_readings[row] = NULL;
+		}
+		else
+		{
+			out.push_back(materialize(row));
+		}
+		m_sequence++;
+	}
+	m_head = 0;
+	m_count = 0;
+	while (spilled() > 0)
+	{
+		SpilledRow *row = (SpilledRow *)m_spill->front();
+		if (skip != m_skipped.cend() && *skip == m_sequence)
+		{
+			skip++;
+			delete row->reading;
+		}
+		else
+		{
+			out.push_back(row->reading ? row->reading : materialize(row));
+		}
+		m_spill->pop();
+		m_sequence++;
+	}
+	m_copies.clear();
+	m_skipped.clear();
+}
+
+/**
+ * Discard the content of the buffer
+ */
+void PretriggerBuffer::clear()
+{
+	m_sequence += size();
+	for (unsigned int i = 0; i < m_count; i++)
+	{
+		unsigned int row = (m_head + i) & m_mask;
+		delete m_readings[row];
+		m_readings[row] = NULL;
+	}
+	m_head = 0;
+	m_count = 0;
+	while (spilled() > 0)
+	{
+		delete ((SpilledRow *)m_spill->front())->reading;
+		m_spill->pop();
+	}
+	m_copies.clear();
+	m_skipped.clear();
+}
+
+/**
+ * Return the memory used by the storage of the ring buffer. The readings
+ * held as they are, rather than in the columns, and the spill file are
+ * not included.
+ *
+ * @return	The size of the storage in bytes
+ */
+size_t PretriggerBuffer::memory() const
+{
+	return m_capacity * rowSize();
+}
+
+/**
+ * Return the memory used by a row of the ring buffer
+ *
+ * @return	The size of a row in bytes
+ */
+size_t PretriggerBuffer::rowSize() const
+{
+	return sizeof(Timestamp) + sizeof(struct timeval) + sizeof(Reading *)
+		+ sizeof(unsigned short) + m_columns.size() * sizeof(Value);
+}
+
+/**
+ * Create a reading from the values stored in a row of the columns
+ *
+ * @param row	The row to create the reading from
+ * @return	The new reading
+ */
+Reading *PretriggerBuffer::materialize(unsigned int row)
+{
+	const Layout& layout = m_layouts[m_rowLayouts[row]];
+	vector<Datapoint *> datapoints;
+	datapoints.reserve(layout.m_columns.size());
+	for (size_t i = 0; i < layout.m_columns.size(); i++)
+	{
+		unsigned int column = layout.m_columns[i];
+		const Value& value = m_columns[column][row];
+		if (layout.m_integer[i])
+		{
+			DatapointValue dpv(value.i);
+			datapoints.push_back(new Datapoint(m_names.name(column), dpv));
+		}
+		else
+		{
+			DatapointValue dpv(value.f);
+			datapoints.push_back(new Datapoint(m_names.name(column), dpv));
+		}
+	}
+	Reading *reading = new Reading(m_asset, datapoints);
+	reading->setUserTimestamp(toTimeval(m_userTimestamps[row]));
+	reading->setTimestamp(m_timestamps[row]);
+	return reading;
+}
+
+/**
+ * Create a reading from a reading spilled to the spill file with its
+ * values in the columns of its layout
+ *
+ * @param row	The spilled reading
+ * @return	The new reading
+ */
+Reading *PretriggerBuffer::materialize(const SpilledRow *row)
+{
+	const Layout& layout = m_layouts[row->layout];
+	const Value *values = (const Value *)(row + 1);
+	vector<Datapoint *> datapoints;
+	datapoints.reserve(layout.m_columns.size());
+	for (size_t i = 0; i < layout.m_columns.size(); i++)
+	{
+		const string& name = m_names.name(layout.m_columns[i]);
+		if (layout.m_integer[i])
+		{
+			DatapointValue dpv(values[i].i);
+			datapoints.push_back(new Datapoint(name, dpv));
+		}
+		else
+		{
+			DatapointValue dpv(values[i].f);
+			datapoints.push_back(new Datapoint(name, dpv));
+		}
+	}
+	Reading *reading = new Reading(m_asset, datapoints);
+	reading->setUserTimestamp(toTimeval(row->userTimestamp));
+	reading->setTimestamp(row->timestamp);
+	return reading;
+}
+
+/**
+ * Find the layout to use for storing a reading in the columns, adding
+ * a new layout if required. Readings with a datapoint name that appears
+ * more than once are held as they are.
+ *
+ * @param datapoints	The datapoints of the reading
+ * @return		The index of the layout or -1 if the reading can
+ *			not be stored in the columns
+ */
+int PretriggerBuffer::findLayout(const vector<Datapoint *>& datapoints)
+{
+	// Readings of an asset will almost always have the same layout
+	if (m_lastLayout != -1 && m_layouts[m_lastLayout].matches(m_names, datapoints))
+	{
+		return m_lastLayout;
+	}
+	for (size_t i = 0; i < m_layouts.size(); i++)
+	{
+		if (m_layouts[i].matches(m_names, datapoints))
+		{
+			m_lastLayout = i;
+			return m_lastLayout;
+		}
+	}
+	if (m_layouts.size() == MAX_LAYOUTS)
+	{
+		return -1;
+	}
+	for (auto it = datapoints.cbegin(); it != datapoints.cend(); ++it)
+	{
+		DatapointValue::dataTagType type = (*it)->getData().getType();
+		if (type != DatapointValue::T_INTEGER && type != DatapointValue::T_FLOAT)
+		{
+			return -1;
+		}
+		// A name that repeats would store both values in one column
+		for (auto prev = datapoints.cbegin(); prev != it; ++prev)
+		{
+			if ((*prev)->getName().compare((*it)->getName()) == 0)
+			{
+				return -1;
+			}
+		}
+	}
+
+	Layout layout;
+	for (auto it = datapoints.cbegin(); it != datapoints.cend(); ++it)
+	{
+		unsigned int column = m_names.intern((*it)->getName());
+		if (column == m_columns.size())
+		{
+			m_columns.push_back(vector<Value>(m_capacity));
+			if (m_budget)
+			{
+				m_budget->charge(m_capacity * sizeof(Value));
+			}
+		}
+		layout.m_columns.push_back(column);
+		layout.m_integer.push_back((*it)->getData().getType() == DatapointValue::T_INTEGER);
+	}
+	m_layouts.push_back(layout);
+	m_lastLayout = m_layouts.size() - 1;
+	return m_lastLayout;
+}
+
+/**
+ * Return the capacity of the ring buffer once it has grown
+ *
+ * @return	The number of rows
+ */
+unsigned int PretriggerBuffer::grownCapacity() const
+{
+	return m_capacity == 0 ? INITIAL_CAPACITY : m_capacity * 2;
+}
+
+/**
+ * Allocate the storage of the ring buffer or double its capacity, moving
+ * the content so that the oldest row is at the start of the storage.
+ */
+void PretriggerBuffer::grow()
+{
+	unsigned int capacity = grownCapacity();
+	if (m_budget)
+	{
+		m_budget->charge((capacity - m_capacity) * rowSize());
+	}
+	vector<Timestamp> userTimestamps(capacity);
+	vector<struct timeval> timestamps(capacity);
+	vector<Reading *> readings(capacity);
+	vector<unsigned short> rowLayouts(capacity);
+	for (unsigned int i = 0; i < m_count; i++)
+	{
+		unsigned int row = (m_head + i) & m_mask;
+		userTimestamps[i] = m_userTimestamps[row];
+		timestamps[i] = m_timestamps[row];
+		readings[i] = m_readings[row];
+		rowLayouts[i] = m_rowLayouts[row];
+	}
+	m_userTimestamps.swap(userTimestamps);
+	m_timestamps.swap(timestamps);
+	m_readings.swap(readings);
+	m_rowLayouts.swap(rowLayouts);
+	for (auto it = m_columns.begin(); it != m_columns.end(); ++it)
+	{
+		vector<Value> column(capacity);
+		for (unsigned int i = 0; i < m_count; i++)
+		{
+			column[i] = (*it)[(m_head + i) & m_mask];
+		}
+		it->swap(column);
+	}
+	m_head = 0;
+	m_capacity = capacity;
+	m_mask = capacity - 1;
+}
+
+/**
+ * Check if the datapoints of a reading match the layout
+ *
+ * @param names		The names of the columns
+ * @param datapoints	The datapoints of the reading
+ * @return		True if the reading can be stored using this layout
+ */
+bool PretriggerBuffer::Layout::matches(const InternTable& names,
+				       const vector<Datapoint *>& datapoints) const
+{
+	if (datapoints.size() != m_columns.size())
+	{
+		return false;
+	}
+	for (size_t i = 0; i < datapoints.size(); i++)
+	{
+		DatapointValue::dataTagType type = datapoints[i]->getData().getType();
+		if (m_integer[i])
+		{
+			if (type != DatapointValue::T_INTEGER)
+			{
+				return false;
+			}
+		}
+		else if (type != DatapointValue::T_FLOAT)
+		{
+			return false;
+		}
+		if (datapoints[i]->getName().compare(names.name(m_columns[i])) != 0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
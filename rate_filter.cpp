@@ -10,14 +10,43 @@
 #include <reading.h>              
 #include <reading_set.h>
 #include <utility>                
+#include <algorithm>
 #include <logger.h>
 #include <exprtk.hpp>
 #include <rate_filter.h>
 #include <sys/time.h>
+#include <time.h>
+#include <ctype.h>
+#include <string.h>
+#include <math.h>
 
 using namespace std;
 using namespace rapidjson;
 
+#define BATCH_THRESHOLD	16	// Minimum number of readings to evaluate the trigger as a batch
+#define EVALUATE_SAMPLE	16	// One in this many expression evaluations is timed, must be a power of 2
+#define PARALLEL_THRESHOLD 1024	// Minimum number of readings to process with the workers
+
+/**
+ * The time of a monotonic clock, used to time the filter
+ */
+static Timestamp monotonicTime()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * NS_PER_SECOND + ts.tv_nsec;
+}
+
+/**
+ * The current time of day
+ */
+static Timestamp wallTime()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return toTimestamp(tv);
+}
+
 /**
  * Construct a RateFilter, call the base class constructor and handle the
  * parsing of the configuration category the required rate
@@ -28,13 +57,16 @@ RateFilter::RateFilter(const std::string& filterName,
                                OUTPUT_STREAM out) :
                                   FogLampFilter(filterName, filterConfig,
                                                 outHandle, out),
-				  m_state(false), m_pretrigger(0), m_averageCount(0),
-				  m_triggerExpression(0), m_untriggerExpression(0),
-				  m_timeWindow(false)
+				  m_pending(NULL), m_pool(NULL), m_nextFlush(0)
 {
-	m_lastSent.tv_sec = 0;
-	m_lastSent.tv_usec = 0;
-	handleConfig(filterConfig);
+	m_current = new Config(filterConfig);
+	m_budget.setLimit(m_current->m_pretriggerMemory);
+	m_counters.add(CountCompiles, m_current->m_compiles);
+	for (int i = 0; i < CountMax; i++)
+	{
+		m_reported[i] = 0;
+	}
+	m_lastStatistics = wallTime();
 }
 
 /**
@@ -42,427 +74,1615 @@ RateFilter::RateFilter(const std::string& filterName,
  */
 RateFilter::~RateFilter()
 {
+	delete m_pool;
+	for (auto it = m_shards.begin(); it != m_shards.end(); ++it)
+	{
+		delete *it;
+	}
+	delete m_current;
+	delete m_pending.load();
+	for (auto it = m_assetStates.begin(); it != m_assetStates.end(); ++it)
+	{
+		delete *it;
+	}
 }
 
 /**
  * Called with a set of readings, iterates over the readings applying
  * the rate filter to create the output readings
  *
+ * A configuration snapshot passed from reconfigure is taken up at the
+ * start of a batch, the ingest thread takes no lock to do this.
+ *
+ * If workers are configured a large batch is partitioned by asset into
+ * shards that are processed in parallel, the outputs of the shards are
+ * then merged in timestamp order. Otherwise the batch is processed in
+ * the order of the readings.
+ *
+ * The work done is counted and a statistics reading is added to the
+ * output if the statistics interval has passed, even if the batch is
+ * empty.
+ *
  * @param readings	The readings to process
  * @param out		The output readings
  */
 void RateFilter::ingest(vector<Reading *> *readings, vector<Reading *>& out)
 {
-	lock_guard<mutex> guard(m_configMutex);
-	if (m_pendingReconfigure)
+	Config *config = m_pending.exchange(NULL);
+	if (config)
+	{
+		bool reductionChanged = config->m_reduction != m_current->m_reduction
+			|| config->m_reductionDatapoint.compare(m_current->m_reductionDatapoint) != 0
+			|| config->m_deviation != m_current->m_deviation;
+		bool periodChanged = config->m_alignPeriods != m_current->m_alignPeriods
+			|| config->m_rate != m_current->m_rate;
+		delete m_current;
+		m_current = config;
+		m_budget.setLimit(m_current->m_pretriggerMemory);
+		// Check every asset for an ended period at the end of the batch
+		m_nextFlush = 0;
+		for (auto it = m_assetStates.begin(); it != m_assetStates.end(); ++it)
+		{
+			(*it)->m_excluded = m_current->isExcluded((*it)->m_asset);
+			if (periodChanged)
+			{
+				// The current period runs from the last time it ended
+				Timestamp t = (*it)->m_lastSent;
+				if (m_current->m_alignPeriods && m_current->m_rate)
+				{
+					t -= t % m_current->m_rate;
+				}
+				(*it)->m_periodStart = t;
+			}
+			if (reductionChanged)
+			{
+				delete (*it)->m_reducer;
+				(*it)->m_reducer = NULL;
+			}
+			// The variables are sized by the new expressions when next used
+			(*it)->m_triggerVariables.clear();
+			(*it)->m_untriggerVariables.clear();
+		}
+	}
+	if (readings->empty())
+	{
+		// The statistics are sent at their interval even with no input
+		publishCounts(out);
+		return;
+	}
+	size_t count = readings->size();
+	size_t output = out.size();
+	m_batch.m_counts[CountReadings] += count;
+	m_batch.m_states.clear();
+	m_batch.m_times.clear();
+	Timestamp now = 0;
+	for (auto it = readings->cbegin(); it != readings->cend(); ++it)
+	{
+		m_batch.m_states.push_back(getAssetState((*it)->getAssetName()));
+		Timestamp tm = userTimestamp(*it);
+		m_batch.m_times.push_back(tm);
+		if (tm > now)
+		{
+			now = tm;
+		}
+	}
+	if (useWorkers(count))
+	{
+		processShards(*readings, out);
+	}
+	else
+	{
+		process(m_batch, *readings, out);
+	}
+	flushPeriods(now, out);
+	readings->clear();
+	m_batch.m_counts[CountOutput] += out.size() - output;
+	publishCounts(out);
+}
+
+/**
+ * Process the readings of a shard, adding the readings to send to the
+ * output. The asset states and timestamps of the readings are held in
+ * the shard.
+ *
+ * Each reading is processed according to the state of its asset. When
+ * a reading changes the state of its asset the same reading is then
+ * processed in the new state, the readings are processed in a single
+ * pass however many state changes there are.
+ *
+ * @param shard		The shard
+ * @param readings	The readings of the shard
+ * @param out		The output readings
+ */
+void RateFilter::process(Shard& shard, const vector<Reading *>& readings, vector<Reading *>& out)
+{
+	Evaluator *trigger = shard.m_trigger ? shard.m_trigger : m_current->m_triggerExpression;
+	Evaluator *untrigger = shard.m_untrigger ? shard.m_untrigger : m_current->m_untriggerExpression;
+	uint64_t *counts = shard.m_counts;
+	trigger->startBatch();
+	untrigger->startBatch();
+	/*
+	 * If the trigger is a simple threshold expression and there are
+	 * enough readings then evaluate the trigger for all of the readings
+	 * in one pass. Readings before the first that may fire the trigger
+	 * need no further evaluation.
+	 */
+	size_t count = readings.size();
+	bool batch = count >= BATCH_THRESHOLD && trigger->isThreshold();
+	size_t first = 0;	// The first reading the batch evaluation did not rule out
+	if (batch)
+	{
+		Timestamp start = monotonicTime();
+		first = trigger->evaluateBatch(readings, shard.m_states, shard.m_results);
+		counts[CountEvaluateTime] += monotonicTime() - start;
+	}
+
+	/*
+	 * Process the readings in order, a reading that changes the state of
+	 * its asset is processed again in the new state.
+	 */
+	size_t offset = 0;
+	bool fired = false;	// The current reading has fired the trigger
+	while (offset < count)
+	{
+		Reading *reading = readings[offset];
+		AssetState *state = shard.m_states[offset];
+		Timestamp tm = shard.m_times[offset];
+		if (state->m_state)
+		{
+			/*
+			 * A reading that has fired the trigger is always sent,
+			 * even if it also satisfies the untrigger expression,
+			 * otherwise the state would never settle.
+			 */
+			if (!fired && endOfTrigger(shard, state, reading, tm))
+			{
+				state->m_state = false;
+				state->m_matches = 0;
+				state->m_armedAt = tm + m_current->m_holdOff;
+				// The reduced rate period restarts with the reading
+				state->m_periodStart = tm;
+				state->m_lastSent = tm;
+				counts[CountUntriggers]++;
+				continue;
+			}
+			out.push_back(reading);
+			counts[CountForwarded]++;
+		}
+		else if (state->m_excluded)
+		{
+			out.push_back(reading);
+			counts[CountForwarded]++;
+		}
+		else
+		{
+			bool triggered;
+			if (batch && offset < first)
+			{
+				triggered = false;
+				trigger->accept(offset, state->m_triggerVariables);
+				counts[CountEvaluations]++;
+			}
+			else if (batch && shard.m_results[offset] != -1)
+			{
+				triggered = shard.m_results[offset];
+				trigger->accept(offset, state->m_triggerVariables);
+				counts[CountEvaluations]++;
+			}
+			else
+			{
+				triggered = evaluate(shard, trigger, state->m_triggerVariables,
+						state, reading);
+			}
+			// A match during the hold off does not count towards the debounce
+			if (debounce(state, triggered && tm >= state->m_armedAt))
+			{
+				state->m_state = true;
+				state->m_matches = 0;
+				state->m_earliestEnd = tm + m_current->m_minimumDuration;
+				counts[CountTriggers]++;
+				clearAverage(state);
+				if (state->m_reducer)
+				{
+					size_t sent = out.size();
+					state->m_reducer->clear(out);
+					expireSent(state, out, sent);
+				}
+				size_t sent = out.size();
+				sendPretrigger(state, out);
+				counts[CountForwarded] += out.size() - sent;
+				state->m_windowClose = tm + m_current->m_fullTime;
+				fired = true;
+				continue;
+			}
+			if (m_current->isCompression())
+			{
+				// Compression does not need a reduced rate period
+				counts[CountReduced]++;
+				reduceReading(shard, state, reading, tm, out);
+			}
+			else if (m_current->m_rate == 0)
+			{
+				// The pretrigger buffer takes ownership of the reading
+				bufferPretrigger(shard, state, reading, tm);
+			}
+			else if (m_current->m_reduction == ReduceAverage)
+			{
+				counts[CountReduced]++;
+				addAverageReading(state, reading, tm, out);
+				bufferPretrigger(shard, state, reading, tm);
+			}
+			else
+			{
+				counts[CountReduced]++;
+				reduceReading(shard, state, reading, tm, out);
+			}
+			if (m_current->m_rate != 0)
+			{
+				Timestamp end = periodEnd(state);
+				if (end < shard.m_nextFlush)
+				{
+					shard.m_nextFlush = end;
+				}
+			}
+		}
+		if (!shard.m_rows.empty())
+		{
+			// Note the row in the batch of the reading the outputs were produced by
+			shard.m_outRows.resize(out.size(), shard.m_rows[offset]);
+		}
+		offset++;
+		fired = false;
+	}
+}
+
+/**
+ * Check if a batch should be processed by the workers. The batch must
+ * be large enough to be worth sharing out and the configuration must
+ * have compiled evaluators for the workers, which it does not if the
+ * expressions use asset qualified names, as the evaluators of a worker
+ * only see the readings of the assets assigned to that worker.
+ *
+ * @param count	The number of readings in the batch
+ * @return	True if the batch is to be processed by the workers
+ */
+bool RateFilter::useWorkers(size_t count)
+{
+	unsigned int workers = m_current->m_workers;
+	if (count < PARALLEL_THRESHOLD || !m_current->isParallel())
+	{
+		return false;
+	}
+	// The ingest thread is one of the workers
+	if (m_pool == NULL || m_pool->threads() != workers - 1)
+	{
+		delete m_pool;
+		m_pool = new WorkerPool(workers - 1);
+	}
+	while (m_shards.size() < workers)
+	{
+		m_shards.push_back(new Shard());
+	}
+	return true;
+}
+
+/**
+ * Partition the readings by asset into a shard per worker and process
+ * the shards in parallel. The state of an asset is only used by the
+ * worker its asset is assigned to.
+ *
+ * @param readings	The readings of the batch
+ * @param out		The output readings
+ */
+void RateFilter::processShards(const vector<Reading *>& readings, vector<Reading *>& out)
+{
+	unsigned int workers = m_current->m_workers;
+	for (unsigned int i = 0; i < workers; i++)
+	{
+		Shard *shard = m_shards[i];
+		shard->clear();
+		if (i == 0)
+		{
+			shard->m_trigger = m_current->m_triggerExpression;
+			shard->m_untrigger = m_current->m_untriggerExpression;
+		}
+		else
+		{
+			shard->m_trigger = m_current->m_workerTriggers[i - 1];
+			shard->m_untrigger = m_current->m_workerUntriggers[i - 1];
+		}
+	}
+	for (size_t i = 0; i < readings.size(); i++)
+	{
+		AssetState *state = m_batch.m_states[i];
+		Shard *shard = m_shards[state->m_id % workers];
+		shard->m_readings.push_back(readings[i]);
+		shard->m_rows.push_back(i);
+		shard->m_states.push_back(state);
+		shard->m_times.push_back(m_batch.m_times[i]);
+	}
+	m_pool->run([this](unsigned int worker) {
+			Shard *shard = m_shards[worker];
+			if (!shard->m_readings.empty())
+			{
+				process(*shard, shard->m_readings, shard->m_out);
+			}
+		}, workers);
+	mergeShards(out);
+}
+
+/**
+ * Merge the outputs of the worker shards into the output in the order
+ * of the readings of the batch that produced them, which is the order
+ * in which processing the whole batch would have produced them. The
+ * outputs of each shard are already in that order.
+ *
+ * @param out	The output readings
+ */
+void RateFilter::mergeShards(vector<Reading *>& out)
+{
+	unsigned int workers = m_current->m_workers;
+	m_mergeNext.assign(workers, 0);
+	for (;;)
+	{
+		int earliest = -1;
+		size_t earliestRow = 0;
+		for (unsigned int i = 0; i < workers; i++)
+		{
+			const Shard *shard = m_shards[i];
+			if (m_mergeNext[i] < shard->m_out.size())
+			{
+				size_t row = shard->m_outRows[m_mergeNext[i]];
+				if (earliest == -1 || row < earliestRow)
+				{
+					earliest = i;
+					earliestRow = row;
+				}
+			}
+		}
+		if (earliest == -1)
+		{
+			break;
+		}
+		out.push_back(m_shards[earliest]->m_out[m_mergeNext[earliest]++]);
+	}
+	for (unsigned int i = 0; i < workers; i++)
+	{
+		m_shards[i]->m_out.clear();
+		m_shards[i]->m_outRows.clear();
+	}
+}
+
+/**
+ * Called when an asset is in the triggered state to determine if the
+ * triggered state should end, either because the time window has
+ * closed or the untrigger expression is satisfied. The triggered state
+ * does not end before the minimum duration has passed.
+ *
+ * If retriggering is enabled the trigger expression is evaluated while
+ * the time window is open and the window is restarted each time the
+ * trigger fires again.
+ *
+ * @param shard		The shard of the reading
+ * @param state		The state of the reading's asset
+ * @param reading	The reading to check
+ * @param tm		The timestamp of the reading
+ * @return		True if the asset should return to the untriggered state
+ */
+bool RateFilter::endOfTrigger(Shard& shard, AssetState *state, Reading *reading, Timestamp tm)
+{
+	if (m_current->m_timeWindow)
+	{
+		if (m_current->m_retrigger)
+		{
+			Evaluator *trigger = shard.m_trigger ? shard.m_trigger : m_current->m_triggerExpression;
+			if (debounce(state, evaluate(shard, trigger, state->m_triggerVariables,
+							state, reading)))
+			{
+				state->m_windowClose = tm + m_current->m_fullTime;
+			}
+		}
+		return tm > state->m_windowClose && tm >= state->m_earliestEnd;
+	}
+	if (tm < state->m_earliestEnd)
+	{
+		return false;
+	}
+	Evaluator *untrigger = shard.m_untrigger ? shard.m_untrigger : m_current->m_untriggerExpression;
+	return debounce(state, evaluate(shard, untrigger, state->m_untriggerVariables,
+				state, reading));
+}
+
+/**
+ * Debounce the result of a trigger or untrigger expression, an
+ * expression must be satisfied by the configured number of consecutive
+ * readings of the asset before the state of the asset changes.
+ *
+ * @param state		The state of the reading's asset
+ * @param matched	The result of the expression for the reading
+ * @return		True if the state of the asset should change
+ */
+bool RateFilter::debounce(AssetState *state, bool matched)
+{
+	if (!matched)
+	{
+		state->m_matches = 0;
+		return false;
+	}
+	return ++state->m_matches >= m_current->m_debounce;
+}
+
+/**
+ * Evaluate an expression for a reading, counting the evaluation. Timing
+ * every evaluation would cost a significant part of the evaluation
+ * itself, so only a sample of the evaluations are timed and the time
+ * spent in the others is estimated from them.
+ *
+ * @param shard		The shard of the reading
+ * @param evaluator	The expression to evaluate
+ * @param variables	The variables of the expression for the asset
+ * @param state		The state of the reading's asset
+ * @param reading	The reading
+ * @return		The result of the expression
+ */
+bool RateFilter::evaluate(Shard& shard, Evaluator *evaluator, Variables& variables,
+			  AssetState *state, Reading *reading)
+{
+	shard.m_counts[CountEvaluations]++;
+	if ((shard.m_evaluateCalls++ & (EVALUATE_SAMPLE - 1)) != 0)
+	{
+		return evaluator->evaluate(variables, state->m_id, reading);
+	}
+	Timestamp start = monotonicTime();
+	bool result = evaluator->evaluate(variables, state->m_id, reading);
+	shard.m_counts[CountEvaluateTime] += (monotonicTime() - start) * EVALUATE_SAMPLE;
+	return result;
+}
+
+/**
+ * Add the counts of the batch just ingested to the running totals and,
+ * if the statistics interval has passed, add a statistics reading to
+ * the output.
+ *
+ * @param out	The output buffer
+ */
+void RateFilter::publishCounts(vector<Reading *>& out)
+{
+	for (int i = 0; i < CountMax; i++)
+	{
+		uint64_t count = m_batch.m_counts[i];
+		m_batch.m_counts[i] = 0;
+		for (auto it = m_shards.begin(); it != m_shards.end(); ++it)
+		{
+			count += (*it)->m_counts[i];
+			(*it)->m_counts[i] = 0;
+		}
+		if (count)
+		{
+			m_counters.add((Count)i, count);
+		}
+	}
+	if (m_current->m_statisticsInterval == 0)
+	{
+		return;
+	}
+	Timestamp now = wallTime();
+	if (now >= m_lastStatistics + m_current->m_statisticsInterval)
+	{
+		out.push_back(statisticsReading(now));
+		m_lastStatistics = now;
+	}
+}
+
+/**
+ * Create a statistics reading with the counts since the last statistics
+ * reading and the current size of the pretrigger buffers and their
+ * spill files.
+ *
+ * @param now	The timestamp of the reading
+ * @return	The statistics reading
+ */
+Reading *RateFilter::statisticsReading(Timestamp now)
+{
+	static const char *names[CountMax] = {
+		"readings",
+		"forwarded",
+		"reduced",
+		"dropped",
+		"output",
+		"triggers",
+		"untriggers",
+		"evaluations",
+		"evaluateTime",
+		"compiles"
+	};
+
+	vector<Datapoint *> datapoints;
+	datapoints.reserve(CountMax + 3);
+	for (int i = 0; i < CountMax; i++)
+	{
+		uint64_t total = m_counters.total((Count)i);
+		DatapointValue dpv((long)(total - m_reported[i]));
+		datapoints.push_back(new Datapoint(names[i], dpv));
+		m_reported[i] = total;
+	}
+	long buffered = 0;
+	long memory = 0;
+	long spilled = 0;
+	for (auto it = m_assetStates.cbegin(); it != m_assetStates.cend(); ++it)
+	{
+		buffered += (*it)->m_buffer.size();
+		memory += (*it)->m_buffer.memory();
+		spilled += (*it)->m_buffer.spillSize();
+	}
+	DatapointValue bufferedValue(buffered);
+	datapoints.push_back(new Datapoint("pretriggerReadings", bufferedValue));
+	DatapointValue memoryValue(memory);
+	datapoints.push_back(new Datapoint("pretriggerBytes", memoryValue));
+	DatapointValue spilledValue(spilled);
+	datapoints.push_back(new Datapoint("pretriggerSpillBytes", spilledValue));
+
+	Reading *reading = new Reading(m_current->m_statisticsAsset, datapoints);
+	struct timeval tm = toTimeval(now);
+	reading->setUserTimestamp(tm);
+	reading->setTimestamp(tm);
+	return reading;
+}
+
+/**
+ * Return the state for an asset, creating a new state if this is
+ * the first time the asset has been seen. Asset names are interned
+ * to a numeric ID that indexes the state table.
+ *
+ * @param asset	The asset name
+ * @return	The state for the asset
+ */
+RateFilter::AssetState *RateFilter::getAssetState(const string& asset)
+{
+	unsigned int id = m_assetNames.intern(asset);
+	if (id < m_assetStates.size())
+	{
+		return m_assetStates[id];
+	}
+	AssetState *state = new AssetState(id, asset, &m_budget);
+	state->m_excluded = m_current->isExcluded(asset);
+	m_assetStates.push_back(state);
+	return state;
+}
+
+/**
+ * Construct the state for a newly seen asset. The asset starts in the
+ * untriggered state with no averaging data.
+ *
+ * @param id		The interned ID of the asset
+ * @param asset		The name of the asset
+ * @param budget	The memory budget of the pretrigger buffers
+ */
+RateFilter::AssetState::AssetState(unsigned int id, const string& asset,
+				   PretriggerBudget *budget) :
+	m_id(id), m_asset(asset), m_excluded(false), m_state(false),
+	m_buffer(asset, budget), m_lastSent(0), m_periodStart(0), m_windowClose(0),
+	m_earliestEnd(0), m_armedAt(0), m_matches(0), m_averageCount(0), m_fieldAccumulators(0), m_fieldStatistics(0),
+	m_reducer(NULL)
+{
+}
+
+/**
+ * Destroy the state of an asset
+ */
+RateFilter::AssetState::~AssetState()
+{
+	delete m_reducer;
+}
+
+/**
+ * Construct an empty shard, the evaluators are those of the configuration
+ * unless set for a worker
+ */
+RateFilter::Shard::Shard() : m_trigger(NULL), m_untrigger(NULL),
+	m_evaluateCalls(0), m_nextFlush(TIMESTAMP_MAX)
+{
+	for (int i = 0; i < CountMax; i++)
+	{
+		m_counts[i] = 0;
+	}
+}
+
+/**
+ * Remove the readings of the previous batch from the shard
+ */
+void RateFilter::Shard::clear()
+{
+	m_readings.clear();
+	m_rows.clear();
+	m_states.clear();
+	m_times.clear();
+}
+
+/**
+ * If we have a pretrigger buffer defined in the configuration then
+ * keep the reading in the pretrigger buffer. Remove any readings
+ * that are older than the defined pretrigger age.
+ *
+ * The pretrigger buffer takes ownership of the reading, if there is
+ * no pretrigger buffering the reading is deleted.
+ *
+ * @param shard		The shard of the reading
+ * @param state		The state of the reading's asset
+ * @param reading	Reading to buffer
+ * @param tm		The timestamp of the reading
+ */
+void RateFilter::bufferPretrigger(Shard& shard, AssetState *state, Reading *reading, Timestamp tm)
+{
+	if (m_current->m_pretrigger == 0)	// No pretrigger buffering
+	{
+		if (m_current->m_rate == 0)
+		{
+			shard.m_counts[CountDropped]++;
+		}
+		delete reading;
+		return;
+	}
+	state->m_buffer.append(reading, tm);
+	expirePretrigger(shard, state, tm);
+}
+
+/**
+ * Keep a copy of a reading in the pretrigger buffer if we have a
+ * pretrigger buffer defined in the configuration. The caller retains
+ * ownership of the reading.
+ *
+ * @param shard		The shard of the reading
+ * @param state		The state of the reading's asset
+ * @param reading	Reading to buffer
+ * @param tm		The timestamp of the reading
+ */
+void RateFilter::copyPretrigger(Shard& shard, AssetState *state, Reading *reading, Timestamp tm)
+{
+	if (m_current->m_pretrigger == 0)	// No pretrigger buffering
+	{
+		return;
+	}
+	state->m_buffer.appendCopy(reading, tm);
+	expirePretrigger(shard, state, tm);
+}
+
+/**
+ * Remove the entries from the front of the pretrigger buffer that are
+ * older than the pre trigger time.
+ *
+ * @param shard	The shard of the asset
+ * @param state	The state of the asset
+ * @param now	The timestamp of the latest reading
+ */
+void RateFilter::expirePretrigger(Shard& shard, AssetState *state, Timestamp now)
+{
+	unsigned int expired = state->m_buffer.expire(now - m_current->m_pretrigger * NS_PER_MS);
+	// With no reduced rate the readings that expire are never sent
+	if (m_current->m_rate == 0 && !m_current->isCompression())
+	{
+		shard.m_counts[CountDropped] += expired;
+	}
+}
+
+/**
+ * Send the pretigger buffer data for an asset
+ *
+ * @param state	The state of the asset that has triggered
+ * @param out	The output buffer
+ */
+void RateFilter::sendPretrigger(AssetState *state, vector<Reading *>& out)
+{
+	state->m_buffer.flush(out);
+}
+
+
+/**
+ * Add a reading to the average data. If the period has enxpired in which
+ * to send a reading then the average will be calculated and added to the
+ * out buffer.
+ *
+ * @param state		The state of the reading's asset
+ * @param reading	The reading to add
+ * @param t1		The timestamp of the reading
+ * @param out		The output buffer to add any average to.
+ */
+void RateFilter::addAverageReading(AssetState *state, Reading *reading, Timestamp t1, vector<Reading *>& out)
+{
+	Timestamp stamp;
+	// An aligned period does not include the reading that ends it
+	if (m_current->m_alignPeriods && endOfPeriod(state, t1, stamp)
+			&& state->m_averageCount > 0)
+	{
+		out.push_back(averageReading(state, stamp));
+	}
+
+	const vector<Datapoint *>& datapoints = reading->getReadingData();
+	for (auto it = datapoints.cbegin(); it != datapoints.cend(); it++)
+	{
+		DatapointValue& dpvalue = (*it)->getData();
+		if (dpvalue.getType() == DatapointValue::T_INTEGER)
+		{
+			addDataPoint(state, (*it)->getName(), (double)dpvalue.toInt());
+		}
+		if (dpvalue.getType() == DatapointValue::T_FLOAT)
+		{
+			addDataPoint(state, (*it)->getName(), dpvalue.toDouble());
+		}
+	}
+	state->m_averageCount++;
+	
+	if (!m_current->m_alignPeriods && endOfPeriod(state, t1, stamp))
+	{
+		out.push_back(averageReading(state, stamp));
+	}
+}
+
+/**
+ * Offer a reading to the reduction engine of the asset. If the period
+ * has expired the readings chosen by the reduction engine are added to
+ * the out buffer. The compression engines may also send the reading
+ * as soon as it is offered, if there is no reduced rate the period
+ * never expires.
+ *
+ * The reading is added to the pretrigger buffer, if the reduction engine
+ * holds the reading a copy of its values is buffered.
+ *
+ * @param shard		The shard of the reading
+ * @param state		The state of the reading's asset
+ * @param reading	The reading to add
+ * @param t1		The timestamp of the reading
+ * @param out		The output buffer
+ */
+void RateFilter::reduceReading(Shard& shard, AssetState *state, Reading *reading, Timestamp t1, vector<Reading *>& out)
+{
+	if (state->m_reducer == NULL)
+	{
+		const string& datapoint = m_current->m_reductionDatapoint;
+		switch (m_current->m_reduction)
+		{
+		case ReduceMinMax:
+			state->m_reducer = new MinMaxReducer(datapoint);
+			break;
+		case ReduceDeadband:
+			state->m_reducer = new DeadbandReducer(datapoint, m_current->m_deviation);
+			break;
+		case ReduceSwingingDoor:
+			state->m_reducer = new SwingingDoorReducer(datapoint, m_current->m_deviation);
+			break;
+		default:
+			state->m_reducer = new LTTBReducer(datapoint);
+			break;
+		}
+	}
+
+	Timestamp stamp;
+	size_t sent = out.size();
+	bool periodic = m_current->m_rate != 0;
+	// An aligned period does not include the reading that ends it
+	if (periodic && m_current->m_alignPeriods && endOfPeriod(state, t1, stamp))
+	{
+		state->m_reducer->close(out);
+	}
+	if (state->m_reducer->add(reading, t1, out))
+	{
+		copyPretrigger(shard, state, reading, t1);
+	}
+	else
+	{
+		bufferPretrigger(shard, state, reading, t1);
+	}
+	if (periodic && !m_current->m_alignPeriods && endOfPeriod(state, t1, stamp))
+	{
+		state->m_reducer->close(out);
+	}
+	expireSent(state, out, sent);
+}
+
+/**
+ * Make sure the readings sent by the reduction of an asset are not sent
+ * again from the pretrigger buffer if the asset triggers. The readings
+ * are marked to be skipped, the readings that were held back by the
+ * reduction are still sent.
+ *
+ * @param state	The state of the asset
+ * @param out	The output buffer
+ * @param sent	The size of the output buffer before the asset was reduced
+ */
+void RateFilter::expireSent(AssetState *state, vector<Reading *>& out, size_t sent)
+{
+	if (out.size() == sent || m_current->m_pretrigger == 0)
+	{
+		return;
+	}
+	for (size_t i = sent; i < out.size(); i++)
+	{
+		state->m_buffer.skip(out[i]);
+	}
+}
+
+/**
+ * Check if the reduced rate period of an asset has ended by a given
+ * time, and if so start a new period. The reduced rate must not be zero.
+ *
+ * Periods either start when the previous period ends at the arrival of
+ * a reading, or are aligned to the clock, e.g. to the start of each
+ * second or minute. A period also starts when the asset untriggers, so
+ * that it covers only readings that were not sent at the full rate.
+ *
+ * @param state	The state of the asset
+ * @param tm	The time, of a reading or of the latest reading ingested
+ * @param stamp	Set to the timestamp for the readings of the ended period
+ * @return	True if the period has ended
+ */
+bool RateFilter::endOfPeriod(AssetState *state, Timestamp tm, Timestamp& stamp)
+{
+	if (tm < periodEnd(state))
+	{
+		return false;
+	}
+	if (m_current->m_alignPeriods)
+	{
+		stamp = state->m_periodStart;
+		state->m_lastSent = tm;
+		state->m_periodStart = tm - tm % m_current->m_rate;
+		return true;
+	}
+	stamp = tm;
+	state->m_lastSent = tm;
+	return true;
+}
+
+/**
+ * Return the earliest time at which the current reduced rate period of
+ * an asset is ended by endOfPeriod. The reduced rate must not be zero.
+ * An aligned period that started part way through, after a trigger,
+ * ends with the clock period it started in.
+ *
+ * @param state	The state of the asset
+ * @return	The end of the current period
+ */
+Timestamp RateFilter::periodEnd(AssetState *state)
+{
+	if (m_current->m_alignPeriods)
+	{
+		return state->m_periodStart - state->m_periodStart % m_current->m_rate
+			+ m_current->m_rate;
+	}
+	return state->m_lastSent + m_current->m_rate + 1;
+}
+
+/**
+ * Close the reduced rate periods that have ended for the assets that
+ * are not triggered, so that the data of an asset that has gone quiet
+ * is not held indefinitely. Called at the end of each ingest.
+ *
+ * The assets are only checked once the earliest end of their periods
+ * has been reached. The shards note the end of the period of each
+ * asset whose readings they reduce, an asset only has an open period
+ * once a reading has been reduced.
+ *
+ * @param now	The timestamp of the latest reading ingested
+ * @param out	The output buffer
+ */
+void RateFilter::flushPeriods(Timestamp now, vector<Reading *>& out)
+{
+	if (m_batch.m_nextFlush < m_nextFlush)
+	{
+		m_nextFlush = m_batch.m_nextFlush;
+	}
+	m_batch.m_nextFlush = TIMESTAMP_MAX;
+	for (auto it = m_shards.begin(); it != m_shards.end(); ++it)
+	{
+		if ((*it)->m_nextFlush < m_nextFlush)
+		{
+			m_nextFlush = (*it)->m_nextFlush;
+		}
+		(*it)->m_nextFlush = TIMESTAMP_MAX;
+	}
+	if (m_current->m_rate == 0 || now < m_nextFlush)
+	{
+		return;
+	}
+	Timestamp stamp;
+	Timestamp next = TIMESTAMP_MAX;
+	for (auto it = m_assetStates.cbegin(); it != m_assetStates.cend(); ++it)
+	{
+		AssetState *state = *it;
+		if (state->m_state || state->m_excluded)
+		{
+			continue;
+		}
+		if (m_current->m_reduction == ReduceAverage)
+		{
+			if (state->m_averageCount > 0 && endOfPeriod(state, now, stamp))
+			{
+				out.push_back(averageReading(state, stamp));
+			}
+			if (state->m_averageCount == 0)
+			{
+				continue;
+			}
+		}
+		else if (state->m_reducer == NULL)
+		{
+			continue;
+		}
+		else if (endOfPeriod(state, now, stamp))
+		{
+			size_t sent = out.size();
+			state->m_reducer->close(out);
+			expireSent(state, out, sent);
+		}
+		Timestamp end = periodEnd(state);
+		if (end < next)
+		{
+			next = end;
+		}
+	}
+	m_nextFlush = next;
+}
+
+/**
+ * Add a data point to the average data
+ *
+ * @param state	The state of the asset being averaged
+ * @param name	The datapoint name
+ * @param value	The datapoint value
+ */
+void RateFilter::addDataPoint(AssetState *state, const string& name, double value)
+{
+	unsigned int id = state->m_datapoints.intern(name);
+	if (id == state->m_accumulators.size())
+	{
+		state->m_accumulators.push_back(Accumulator());
+	}
+	state->m_accumulators[id].add(value);
+}
+
+/**
+ * Create an average reading using the asset name, the timestamp given
+ * and the data accumulated in the average map of the asset
+ *
+ * The mean of a datapoint is sent using the datapoint name, the other
+ * statistics are sent as datapoints with the name of the statistic
+ * appended to the datapoint name, e.g. X_max. The names and the order
+ * of the datapoints are taken from the fields of the asset, so no names
+ * are built here. The reading and each of its datapoints are still
+ * created for every average, as the readings sent are owned by the
+ * rest of the filter chain.
+ *
+ * @param state		The state of the asset being averaged
+ * @param timestamp	The timestamp of the average reading
+ */
+Reading *RateFilter::averageReading(AssetState *state, Timestamp timestamp)
+{
+	if (state->m_fieldAccumulators != state->m_accumulators.size()
+		|| state->m_fieldStatistics != m_current->m_statistics)
+	{
+		buildFields(state);
+	}
+
+	vector<Datapoint *>	datapoints;
+	datapoints.reserve(state->m_fields.size());
+	for (auto it = state->m_fields.cbegin(); it != state->m_fields.cend(); ++it)
+	{
+		const Accumulator& acc = state->m_accumulators[it->m_accumulator];
+		if (it->m_statistic == StatCount)
+		{
+			DatapointValue dpv(acc.m_count);
+			datapoints.push_back(new Datapoint(it->m_name, dpv));
+			continue;
+		}
+		if (acc.m_count == 0)
+		{
+			continue;
+		}
+		double value = 0.0;
+		switch (it->m_statistic)
+		{
+		case StatMean:
+			// Only the readings that had the datapoint
+			value = acc.m_sum / acc.m_count;
+			break;
+		case StatMin:
+			value = acc.m_min;
+			break;
+		case StatMax:
+			value = acc.m_max;
+			break;
+		case StatFirst:
+			value = acc.m_first;
+			break;
+		case StatLast:
+			value = acc.m_last;
+			break;
+		case StatVariance:
+			value = acc.m_m2 / acc.m_count;
+			break;
+		case StatStddev:
+			value = sqrt(acc.m_m2 / acc.m_count);
+			break;
+		default:
+			break;
+		}
+		DatapointValue dpv(value);
+		datapoints.push_back(new Datapoint(it->m_name, dpv));
+	}
+	clearAverage(state);
+
+	Reading	*rval = new Reading(state->m_asset, datapoints);
+	struct timeval tm = toTimeval(timestamp);
+	rval->setUserTimestamp(tm);
+	rval->setTimestamp(tm);
+	return rval;
+}
+
+/**
+ * Build the fields of the average readings of an asset, the datapoint
+ * name and statistic of each datapoint in the order they are sent. The
+ * fields are rebuilt when a new datapoint is seen or the statistics to
+ * send are reconfigured.
+ *
+ * @param state	The state of the asset
+ */
+void RateFilter::buildFields(AssetState *state)
+{
+	static const struct {
+		Statistic	statistic;
+		const char	*suffix;
+	} statistics[] = {
+		{ StatMean,	"" },
+		{ StatMin,	"_min" },
+		{ StatMax,	"_max" },
+		{ StatFirst,	"_first" },
+		{ StatLast,	"_last" },
+		{ StatVariance,	"_variance" },
+		{ StatStddev,	"_stddev" },
+		{ StatCount,	"_count" }
+	};
+
+	state->m_fields.clear();
+	for (unsigned int id = 0; id < state->m_accumulators.size(); id++)
+	{
+		const string& name = state->m_datapoints.name(id);
+		for (unsigned int i = 0; i < sizeof(statistics) / sizeof(statistics[0]); i++)
+		{
+			if (m_current->m_statistics & statistics[i].statistic)
+			{
+				Field field;
+				field.m_accumulator = id;
+				field.m_statistic = statistics[i].statistic;
+				field.m_name = name + statistics[i].suffix;
+				state->m_fields.push_back(field);
+			}
+		}
+	}
+	state->m_fieldAccumulators = state->m_accumulators.size();
+	state->m_fieldStatistics = m_current->m_statistics;
+}
+
+/**
+ * Clear the average data of an asset having triggered a change of state
+ *
+ * @param state	The state of the asset that has changed state
+ */
+void RateFilter::clearAverage(AssetState *state)
+{
+	for (auto it = state->m_accumulators.begin(); it != state->m_accumulators.end(); ++it)
+	{
+		it->clear();
+	}
+	state->m_averageCount = 0;
+}
+
+/**
+ * Add a value to the statistics of a datapoint
+ *
+ * @param value	The datapoint value
+ */
+void RateFilter::Accumulator::add(double value)
+{
+	if (m_count == 0)
+	{
+		m_min = value;
+		m_max = value;
+		m_first = value;
+	}
+	else if (value < m_min)
+	{
+		m_min = value;
+	}
+	else if (value > m_max)
+	{
+		m_max = value;
+	}
+	m_last = value;
+	m_sum += value;
+	m_count++;
+	double delta = value - m_mean;
+	m_mean += delta / m_count;
+	m_m2 += delta * (value - m_mean);
+}
+
+/**
+ * Reset the statistics at the start of a new period
+ */
+void RateFilter::Accumulator::clear()
+{
+	m_sum = 0.0;
+	m_min = 0.0;
+	m_max = 0.0;
+	m_first = 0.0;
+	m_last = 0.0;
+	m_mean = 0.0;
+	m_m2 = 0.0;
+	m_count = 0;
+}
+
+/**
+ * Constructor for the evaluator class. This holds the expressions and
+ * variable bindings used to execute the triggers.
+ *
+ * The variables are those that appear in the expression, the expression
+ * is compiled once here and the datapoints of the readings are bound to
+ * the variables as each asset is seen.
+ *
+ * @parsm expression	The expression to evaluate
+ */
+RateFilter::Evaluator::Evaluator(const string& expression) :
+	m_unassigned(0), m_compiled(false), m_native(false), m_qualified(false),
+	m_batch(1)
+{
+	m_expressionStr = expression;
+	m_symbolTable.add_constants();
+	vector<string> variables;
+	if (!exprtk::collect_variables(expression, variables))
+	{
+		Logger::getLogger()->error("Expression compilation failed: %s", expression.c_str());
+		return;
+	}
+	for (auto it = variables.begin(); it != variables.end(); ++it)
+	{
+		// Constants such as pi may be reported as variables
+		if (!m_symbolTable.symbol_exists(*it))
+		{
+			m_variableNames.intern(lower(*it));
+			m_qualified |= it->find('.') != string::npos;
+		}
+	}
+
+	/*
+	 * The storage for the variables is allocated once, the symbol
+	 * table holds the address of each variable.
+	 */
+	m_variables.assign(m_variableNames.size(), 0.0);
+	for (unsigned int i = 0; i < m_variableNames.size(); i++)
+	{
+		m_symbolTable.add_variable(m_variableNames.name(i), m_variables[i]);
+	}
+	/*
+	 * Variables qualified by an asset name are shared by all assets,
+	 * the values of the other variables are held for each asset.
+	 */
+	m_shared.assign(m_variables.size(), false);
+	for (unsigned int i = 0; i < m_variableNames.size(); i++)
+	{
+		if (m_variableNames.name(i).find('.') != string::npos)
+		{
+			m_shared[i] = true;
+			m_unassigned++;
+		}
+		else
+		{
+			m_assetSlots.push_back(i);
+		}
+	}
+	m_assigned.assign(m_variables.size(), false);
+
+	m_expression.register_symbol_table(m_symbolTable);
+	if (!m_parser.compile(expression.c_str(), m_expression))
+	{
+		Logger::getLogger()->error("Expression compilation failed: %s", m_parser.error().c_str());
+		return;
+	}
+	m_compiled = true;
+	// Simple threshold expressions are evaluated natively
+	if (m_threshold.parse(expression))
+	{
+		bindThreshold();
+	}
+}
+
+/**
+ * Evaluate an expression using the reading provided and return true of false. 
+ *
+ * The datapoints of the reading are bound to the variable slots of the
+ * expression the first time an asset is seen, or if the datapoints in
+ * the readings of the asset change. The values of the datapoints are
+ * then stored in the variables of the asset, or in the slots of the
+ * variables shared by all assets, and the values of the asset are
+ * loaded into the slots before the expression is evaluated. The
+ * expression evaluates to false until the asset has given a value to
+ * each of its variables and every shared variable has a value.
+ *
+ * @param	variables	The variables of the asset of the reading
+ * @param	assetId	The interned ID of the asset of the reading
+ * @param	reading	The reading from which the variables are taken
+ * @return	Bool result of evaluatign the expression
+ */
+bool RateFilter::Evaluator::evaluate(Variables& variables, unsigned int assetId, Reading *reading)
+{
+	if (!m_compiled)
+	{
+		return false;
+	}
+	prepare(variables);
+	if (assetId >= m_bindings.size())
+	{
+		m_bindings.resize(assetId + 1);
+	}
+	Binding& binding = m_bindings[assetId];
+	const vector<Datapoint *>& datapoints = reading->getReadingData();
+	if (!binding.matches(datapoints, m_batch))
 	{
-		if (m_triggerExpression)
-			delete m_triggerExpression;
-		if (m_untriggerExpression)
-			delete m_untriggerExpression;
-		m_triggerExpression = 0;
-		m_untriggerExpression = 0;
-		m_pendingReconfigure = false;
+		bind(binding, reading->getAssetName(), datapoints);
 	}
-	// Use the first reading to create the evaluators if we do not already have them
-	if (m_triggerExpression == 0)
+	for (size_t i = 0; i < datapoints.size(); i++)
 	{
-		Reading *firstReading = readings->front();
-		m_triggerExpression = new Evaluator(firstReading, m_trigger);
-		if (!m_untrigger.empty())
+		const Slots& slots = binding.m_slots[i];
+		if (slots.name == -1 && slots.qualified == -1)
 		{
-			m_untriggerExpression = new Evaluator(firstReading, m_untrigger);
+			continue;
 		}
-		else
+		double value = 0.0;
+		DatapointValue& dpvalue = datapoints[i]->getData();
+		if (dpvalue.getType() == DatapointValue::T_INTEGER)
+		{
+			value = dpvalue.toInt();
+		}
+		else if (dpvalue.getType() == DatapointValue::T_FLOAT)
 		{
-			m_untriggerExpression = new Evaluator(firstReading, string("! (")
-							+ m_untrigger + string(")"));
+			value = dpvalue.toDouble();
+		}
+		if (slots.name != -1)
+		{
+			store(variables, slots.name, value);
+		}
+		if (slots.qualified != -1)
+		{
+			store(variables, slots.qualified, value);
 		}
 	}
-	if (m_state)
+	if (variables.m_unassigned || m_unassigned)
 	{
-		triggeredIngest(readings, out);
+		return false;
 	}
-	else
+	for (auto it = m_assetSlots.cbegin(); it != m_assetSlots.cend(); ++it)
+	{
+		m_variables[*it] = variables.m_values[*it];
+	}
+	if (m_native)
 	{
-		untriggeredIngest(readings, out);
+		return m_threshold.evaluate(m_variables.data());
 	}
+	return m_expression.value() != 0.0;
 }
 
 /**
- * Called when in the triggered state to forward the readings and evaluate the
- * untrigger expression. If the state changes to untrigger then the untriggerIngest
- * method will be called.
+ * Size the variables of an asset for the expression if the asset has
+ * not been evaluated since the expression was compiled
  *
- * @param readings	The readings to process
- * @param out		The output readings
+ * @param variables	The variables of the asset
  */
-void RateFilter::triggeredIngest(vector<Reading *> *readings, vector<Reading *>& out)
+void RateFilter::Evaluator::prepare(Variables& variables)
 {
-int	offset = 0;	// Offset within the vector
-
-	for (vector<Reading *>::const_iterator reading = readings->begin();
-						      reading != readings->end();
-						      ++reading)
+	if (variables.m_unassigned != -1)
 	{
-		if (m_timeWindow)
-		{
-			struct timeval tm;
-			(*reading)->getUserTimestamp(&tm);
-			if (timercmp(&tm, &m_windowClose, >))
-			{
-				m_state = false;
-				// Remove the readings we have dealt with
-				readings->erase(readings->begin(), readings->begin() + offset);
-				return untriggeredIngest(readings, out);
-			}
-		}
-		else if (m_untriggerExpression->evaluate(*reading))
-		{
-			m_state = false;
-			// Remove the readings we have dealt with
-			readings->erase(readings->begin(), readings->begin() + offset);
-			return untriggeredIngest(readings, out);
-		}
-		out.push_back(*reading);
-		offset++;
+		return;
 	}
-	readings->clear();
+	variables.m_values.assign(m_variables.size(), 0.0);
+	variables.m_assigned.assign(m_variables.size(), false);
+	variables.m_unassigned = m_assetSlots.size();
 }
 
 /**
- * Called when in the triggered state to average the readings and evaluate the
- * trigger expression. If the state changes to untrigger then the triggerIngest
- * method will be called.
+ * Store the value of a variable, in the variables of the asset or, for
+ * a variable shared by all assets, in the slot of the variable
  *
- * @param readings	The readings to process
- * @param out		The output readings
+ * @param variables	The variables of the asset
+ * @param slot		The variable slot
+ * @param value		The value of the variable
  */
-void RateFilter::untriggeredIngest(vector<Reading *> *readings, vector<Reading *>& out)
+void RateFilter::Evaluator::store(Variables& variables, int slot, double value)
 {
-int	offset = 0;	// Offset within the vector
-
-	for (vector<Reading *>::const_iterator reading = readings->begin();
-						      reading != readings->end();
-						      ++reading)
+	if (m_shared[slot])
 	{
-		if (m_triggerExpression->evaluate(*reading))
+		m_variables[slot] = value;
+		if (!m_assigned[slot])
 		{
-			m_state = true;
-			clearAverage();
-			// Remove the readings we have dealt with
-			readings->erase(readings->begin(), readings->begin() + offset);
-			sendPretrigger(out);
-			struct timeval tm;
-			(*reading)->getUserTimestamp(&tm);
-			timeradd(&tm, &m_fullTime, &m_windowClose);
-			return triggeredIngest(readings, out);
+			m_assigned[slot] = true;
+			m_unassigned--;
 		}
-		if (isExcluded((*reading)->getAssetName()))
+		return;
+	}
+	variables.m_values[slot] = value;
+	if (!variables.m_assigned[slot])
+	{
+		variables.m_assigned[slot] = true;
+		variables.m_unassigned--;
+	}
+}
+
+/**
+ * Bind the variables of a threshold expression to the variable slots.
+ * The native predicate is only used if the expression compiled and all
+ * of its variables are bound.
+ */
+void RateFilter::Evaluator::bindThreshold()
+{
+	m_native = m_compiled && !m_threshold.m_terms.empty();
+	for (auto it = m_threshold.m_terms.begin(); m_native && it != m_threshold.m_terms.end(); ++it)
+	{
+		it->m_slot = findVariable(it->m_variable);
+		if (it->m_slot == -1)
 		{
-			out.push_back(*reading);
+			m_native = false;
 		}
-		else
+	}
+
+	// Allocate a column for each distinct slot used by the terms
+	m_slotColumns.assign(m_variables.size(), -1);
+	m_columnSlots.clear();
+	m_termColumns.clear();
+	for (auto it = m_threshold.m_terms.cbegin(); m_native && it != m_threshold.m_terms.cend(); ++it)
+	{
+		if (m_slotColumns[it->m_slot] == -1)
 		{
-			bufferPretrigger(*reading);
-			if (m_rate.tv_sec != 0 || m_rate.tv_usec != 0)
-			{
-				addAverageReading(*reading, out);
-			}
-			delete *reading;
+			m_slotColumns[it->m_slot] = m_columnSlots.size();
+			m_columnSlots.push_back(it->m_slot);
 		}
-		offset++;
+		m_termColumns.push_back(m_slotColumns[it->m_slot]);
 	}
-	readings->clear();
+	m_columns.resize(m_columnSlots.size());
 }
 
 /**
- * If we have a pretrigger buffer defined in the configuration then
- * keep a copy of the reading int he pretrigger buffer. Remove any readings
- * that are older than the defined pretrigger age.
+ * Evaluate a threshold expression for a batch of readings. The values of
+ * the variables used by the expression are gathered into a column per
+ * variable and the predicate is then evaluated over the columns.
  *
- * @param reading	Reading to buffer
+ * Only the readings that provide a value for every variable of the
+ * expression are evaluated in the batch, as the result for other readings
+ * depends on values left by earlier readings. Readings of assets that are
+ * excluded are also left to be evaluated individually.
+ *
+ * The caller must call accept for each reading for which it uses the
+ * batch result, so that the variables of the asset reflect the reading
+ * when the asset is next evaluated individually.
+ *
+ * @param readings	The readings to evaluate
+ * @param states	The state of the asset of each reading
+ * @param results	The result for each reading, 1 if the trigger
+ *			fires, 0 if it does not and -1 if the reading
+ *			must be evaluated individually
+ * @return		The index of the first reading that is not known
+ *			to leave the trigger unfired
  */
-void RateFilter::bufferPretrigger(Reading *reading)
+size_t RateFilter::Evaluator::evaluateBatch(const vector<Reading *>& readings,
+					    const vector<AssetState *>& states,
+					    vector<signed char>& results)
 {
-Reading	*t;
-struct timeval	now, t1, t2, res;
+	size_t rows = readings.size();
 
-	if (m_pretrigger == 0)	// No pretrigger buffering
+	results.assign(rows, -1);
+	if (!m_native)
 	{
-		return;
+		return 0;
 	}
-	m_buffer.push_back(new Reading(*reading));
+	for (auto it = m_columns.begin(); it != m_columns.end(); ++it)
+	{
+		if (it->size() < rows)
+		{
+			it->resize(rows);
+		}
+	}
+	m_columnRows.assign(m_columns.size(), 0);
+	m_known.assign(rows, 0);
+	m_fired.resize(rows);
 
-	/*
-	 * Remove the entries from the front of the pretrigger buffer taht are
-	 * older than the pre trigger time.
-	 */
-	t2.tv_sec = m_pretrigger / 1000;
-	t2.tv_usec = (m_pretrigger % 1000) * 1000;
-	for (;;)
+	for (size_t row = 0; row < rows; row++)
 	{
-		t = m_buffer.front();
-		t->getUserTimestamp(&t1);
-		reading->getUserTimestamp(&now);
-		timersub(&now, &t1, &res);
-		if (timercmp(&res, &t2, >))
+		AssetState *state = states[row];
+		if (state->m_excluded)
 		{
-			t = m_buffer.front();
-			delete t;
-			m_buffer.pop_front();
+			continue;
 		}
-		else
+		if (state->m_id >= m_bindings.size())
 		{
-			break;
+			m_bindings.resize(state->m_id + 1);
+		}
+		Binding& binding = m_bindings[state->m_id];
+		const vector<Datapoint *>& datapoints = readings[row]->getReadingData();
+		if (!binding.matches(datapoints, m_batch))
+		{
+			bind(binding, state->m_asset, datapoints);
+		}
+		size_t bound = 0;
+		for (size_t i = 0; i < datapoints.size(); i++)
+		{
+			const Slots& slots = binding.m_slots[i];
+			int name = slots.name == -1 ? -1 : m_slotColumns[slots.name];
+			int qualified = slots.qualified == -1 ? -1 : m_slotColumns[slots.qualified];
+			if (name == -1 && qualified == -1)
+			{
+				continue;
+			}
+			double value = 0.0;
+			DatapointValue& dpvalue = datapoints[i]->getData();
+			if (dpvalue.getType() == DatapointValue::T_INTEGER)
+			{
+				value = dpvalue.toInt();
+			}
+			else if (dpvalue.getType() == DatapointValue::T_FLOAT)
+			{
+				value = dpvalue.toDouble();
+			}
+			if (name != -1)
+			{
+				m_columns[name][row] = value;
+				if (m_columnRows[name] != row + 1)
+				{
+					m_columnRows[name] = row + 1;
+					bound++;
+				}
+			}
+			if (qualified != -1)
+			{
+				m_columns[qualified][row] = value;
+				if (m_columnRows[qualified] != row + 1)
+				{
+					m_columnRows[qualified] = row + 1;
+					bound++;
+				}
+			}
 		}
+		m_known[row] = (bound == m_columns.size());
 	}
-}
 
-/**
- * Send the pretigger buffer data
- *
- * @param out	The output buffer
- */
-void RateFilter::sendPretrigger(vector<Reading *>& out)
-{
-	while (!m_buffer.empty())
+	vector<const double *> columns;
+	for (auto it = m_termColumns.cbegin(); it != m_termColumns.cend(); ++it)
 	{
-		Reading *r = m_buffer.front();
-		out.push_back(r);
-		m_buffer.pop_front();
+		columns.push_back(m_columns[*it].data());
 	}
-}
+	m_threshold.evaluate(columns.data(), rows, m_fired.data());
 
-
-/**
- * Add a reading to the average data. If the period has enxpired in which
- * to send a reading then the average will be calculated and added to the
- * out buffer.
- *
- * @param reading	The reading to add
- * @param out		The output buffer to add any average to.
- */
-void RateFilter::addAverageReading(Reading *reading, vector<Reading *>& out)
-{
-	vector<Datapoint *>	datapoints = reading->getReadingData();
-	for (auto it = datapoints.begin(); it != datapoints.end(); it++)
+	size_t first = rows;
+	for (size_t row = 0; row < rows; row++)
 	{
-		DatapointValue& dpvalue = (*it)->getData();
-		if (dpvalue.getType() == DatapointValue::T_INTEGER)
+		if (m_known[row])
 		{
-			addDataPoint((*it)->getName(), (double)dpvalue.toInt());
+			results[row] = m_fired[row] ? 1 : 0;
 		}
-		if (dpvalue.getType() == DatapointValue::T_FLOAT)
+		if (first == rows && results[row] != 0)
 		{
-			addDataPoint((*it)->getName(), dpvalue.toDouble());
+			first = row;
 		}
 	}
-	m_averageCount++;
-	
-	struct timeval t1, res;
-	reading->getUserTimestamp(&t1);
-	timeradd(&m_lastSent, &m_rate, &res);
-	if (timercmp(&t1, &res, >))
-	{
-		out.push_back(averageReading(reading));
-		m_lastSent = t1;
-	}
+	return first;
 }
 
 /**
- * Add a data point to the average data
+ * Store the values of a reading whose result has been taken from a
+ * batch evaluation in the variables. Only readings that gave a value
+ * to every variable are evaluated in the batch.
  *
- * @param name	The datapoint name
- * @param value	The datapoint value
+ * @param row		The row of the reading in the batch
+ * @param variables	The variables of the asset of the reading
  */
-void RateFilter::addDataPoint(const string& name, double value)
+void RateFilter::Evaluator::accept(size_t row, Variables& variables)
 {
-	map<string, double>::iterator it = m_averageMap.find(name);
-	if (it != m_averageMap.end())
-	{
-		it->second += value;
-	}
-	else
+	prepare(variables);
+	for (size_t column = 0; column < m_columnSlots.size(); column++)
 	{
-		m_averageMap.insert(pair<string, double>(name, value));
+		store(variables, m_columnSlots[column], m_columns[column][row]);
 	}
 }
 
 /**
- * Create a average reading using the asset name and times from the reading
- * passed in and the data accumulated in the average map
+ * Resolve the datapoints of a reading to the variable slots they should
+ * be stored in and cache the result in the binding for the asset.
  *
- * @param reading	The reading to take the asset name and times from
+ * @param binding	The binding to populate
+ * @param asset		The asset name of the reading
+ * @param datapoints	The datapoints of the reading
  */
-Reading *RateFilter::averageReading(Reading *templateReading)
+void RateFilter::Evaluator::bind(Binding& binding, const string& asset,
+				 const vector<Datapoint *>& datapoints)
 {
-string			asset = templateReading->getAssetName();
-vector<Datapoint *>	datapoints;
-
-	for (map<string, double>::iterator it = m_averageMap.begin();
-				it != m_averageMap.end(); it++)
+	binding.m_names.clear();
+	binding.m_slots.clear();
+	for (auto it = datapoints.cbegin(); it != datapoints.cend(); ++it)
 	{
-		DatapointValue dpv(it->second / m_averageCount);
-		it->second = 0.0;
-		datapoints.push_back(new Datapoint(it->first, dpv));
+		string name = (*it)->getName();
+		Slots slots;
+		slots.name = findVariable(name);
+		slots.qualified = findVariable(asset + "." + name);
+		binding.m_names.push_back(name);
+		binding.m_slots.push_back(slots);
 	}
-	m_averageCount = 0;
-	Reading	*rval = new Reading(asset, datapoints);
-	struct timeval tm;
-	templateReading->getUserTimestamp(&tm);
-	rval->setUserTimestamp(tm);
-	templateReading->getTimestamp(&tm);
-	rval->setTimestamp(tm);
-	return rval;
+	binding.m_datapoints.assign(datapoints.cbegin(), datapoints.cend());
+	binding.m_batch = m_batch;
 }
 
 /**
- * Clear the average data having triggered a change of state
+ * Find the slot of the named variable. Variable names in exprtk are not
+ * case sensitive, the names are held in lower case.
  *
+ * @param name	The variable name
+ * @return	The slot of the variable or -1 if there is no such variable
  */
-void RateFilter::clearAverage()
+int RateFilter::Evaluator::findVariable(const string& name) const
 {
-	for (map<string, double>::iterator it = m_averageMap.begin();
-				it != m_averageMap.end(); it++)
+	unsigned int slot = m_variableNames.find(lower(name));
+	if (slot == INTERN_NOT_FOUND)
 	{
-		it->second = 0.0;
+		return -1;
 	}
+	return slot;
 }
 
 /**
- * Constructor for the evaluator class. This holds the expressions and
- * variable bindings used to execute the triggers.
+ * Return the lower case form of a name
  *
- * @param reading	An initial reading to use to create varaibles
- * @parsm expression	The expression to evaluate
+ * @param name	The name
+ * @return	The name in lower case
  */
-RateFilter::Evaluator::Evaluator(Reading *reading, const string& expression) : m_varCount(0), m_compiled(false)
+string RateFilter::Evaluator::lower(const string& name)
 {
-	vector<Datapoint *>	datapoints = reading->getReadingData();
-	for (auto it = datapoints.begin(); it != datapoints.end(); it++)
-	{
-		DatapointValue& dpvalue = (*it)->getData();
-		if (dpvalue.getType() == DatapointValue::T_INTEGER ||
-				dpvalue.getType() == DatapointValue::T_FLOAT)
-		{
-			m_variableNames[m_varCount++] = (*it)->getName();
-			m_variableNames[m_varCount++] = reading->getAssetName() + "." + (*it)->getName();
-		}
-		if (m_varCount == MAX_EXPRESSION_VARIABLES)
-		{
-			Logger::getLogger()->error("Too many datapoints in reading");
-			break;
-		}
-	}
-
-	for (int i = 0; i < m_varCount; i++)
-	{
-		m_symbolTable.add_variable(m_variableNames[i], m_variables[i]);
-	}
-	m_expressionStr = expression;
-	m_symbolTable.add_constants();
-	m_expression.register_symbol_table(m_symbolTable);
-	m_compiled = true;
-	if (!m_parser.compile(expression.c_str(), m_expression))
+	string rval(name);
+	for (size_t i = 0; i < rval.length(); i++)
 	{
-		Logger::getLogger()->error("Expression compilation failed: %s", m_parser.error().c_str());
-		m_compiled = false;
+		rval[i] = tolower((unsigned char)rval[i]);
 	}
-	m_assets.push_back(new string(reading->getAssetName()));
+	return rval;
 }
 
 /**
- * Evaluate an expression using the reading provided and return true of false. 
+ * Check if the binding is for the set of datapoints given
  *
- * @param	reading	The reading from which the variables are taken
- * @return	Bool result of evaluatign the expression
+ * The names of the datapoints are returned by value, which allocates
+ * for long names, so if the datapoints are the very ones last matched
+ * the names are not compared again. This is only done within a batch,
+ * as the readings of a batch are not freed until the batch has been
+ * processed, whereas the storage of a datapoint of an earlier batch
+ * may since have been reused for a different datapoint.
+ *
+ * @param datapoints	The datapoints of a reading
+ * @param batch		The batch the reading is in
+ * @return		True if the binding may be used for the datapoints
  */
-bool RateFilter::Evaluator::evaluate(Reading *reading)
+bool RateFilter::Evaluator::Binding::matches(const vector<Datapoint *>& datapoints,
+					      unsigned long batch)
 {
-	// Check first to see if we have seen this reading asset before
-	bool newAsset = true;
-	string asset = reading->getAssetName();
-	for (auto it = m_assets.cbegin(); it != m_assets.cend(); ++it)
+	if (datapoints.size() != m_names.size())
 	{
-		if ((*it)->compare(asset) == 0)
-		{
-			newAsset = false;
-			break;
-		}
+		return false;
 	}
-	if (newAsset)	// Need to add variables for this asset
+	if (batch == m_batch && equal(datapoints.cbegin(), datapoints.cend(), m_datapoints.cbegin()))
 	{
-		vector<Datapoint *>	datapoints = reading->getReadingData();
-		for (auto it = datapoints.begin(); it != datapoints.end(); it++)
-		{
-			DatapointValue& dpvalue = (*it)->getData();
-			if (dpvalue.getType() == DatapointValue::T_INTEGER ||
-					dpvalue.getType() == DatapointValue::T_FLOAT)
-			{
-				m_variableNames[m_varCount++] = reading->getAssetName() + "." + (*it)->getName();
-			}
-			if (m_varCount == MAX_EXPRESSION_VARIABLES)
-			{
-				Logger::getLogger()->error("Too many datapoints in reading");
-				break;
-			}
-		}
-
-		for (int i = 0; i < m_varCount; i++)
-		{
-			m_symbolTable.add_variable(m_variableNames[i], m_variables[i]);
-		}
-		m_symbolTable.add_constants();
-		m_expression.register_symbol_table(m_symbolTable);
-		if (!m_parser.compile(m_expressionStr.c_str(), m_expression))
-		{
-			Logger::getLogger()->error("Expression compilation failed: %s", m_parser.error().c_str());
-			m_compiled = false;
-		}
-		else
-		{
-			m_compiled = true;
-		}
-		m_assets.push_back(new string(asset));
+		return true;
 	}
-
-	vector<Datapoint *> datapoints = reading->getReadingData();
-	for (auto it = datapoints.begin(); it != datapoints.end(); it++)
+	for (size_t i = 0; i < datapoints.size(); i++)
 	{
-		string name = (*it)->getName();
-		double value = 0.0;
-		DatapointValue& dpvalue = (*it)->getData();
-		if (dpvalue.getType() == DatapointValue::T_INTEGER)
-		{
-			value = dpvalue.toInt();
-		}
-		else if (dpvalue.getType() == DatapointValue::T_FLOAT)
-		{
-			value = dpvalue.toDouble();
-		}
-		
-		string fullname = reading->getAssetName() + "." + name;
-		for (int i = 0; i < m_varCount; i++)
+		if (datapoints[i]->getName().compare(m_names[i]) != 0)
 		{
-			if (m_variableNames[i].compare(name) == 0)
-			{
-				m_variables[i] = value;
-			}
-			else if (m_variableNames[i].compare(fullname) == 0)
-			{
-				m_variables[i] = value;
-			}
+			return false;
 		}
 	}
-	if (m_compiled)
-	{
-		return m_expression.value() != 0.0;
-	}
-	else
-	{
-		return false;
-	}
+	m_datapoints.assign(datapoints.cbegin(), datapoints.cend());
+	m_batch = batch;
+	return true;
 }
 
 /**
@@ -474,22 +1694,36 @@ void RateFilter::reconfigure(const string& newConfig)
 {
 	lock_guard<mutex> guard(m_configMutex);
 	setConfig(newConfig);
-	handleConfig(m_config);
-	m_pendingReconfigure = true;
+	Config *config = new Config(m_config);
+	m_counters.add(CountCompiles, config->m_compiles);
+	// Replace any snapshot the ingest thread has not yet taken up
+	delete m_pending.exchange(config);
 }
 
 
 /**
- * Handle the configuration of the plugin.
- *
+ * Handle the configuration of the plugin, creating a snapshot of the
+ * configuration. The trigger expressions are compiled here rather
+ * than when readings are processed.
  *
  * @param conf	The configuration category for the filter.
  */
-void RateFilter::handleConfig(const ConfigCategory& config)
+RateFilter::Config::Config(const ConfigCategory& config) :
+	m_rate(0), m_pretrigger(0), m_fullTime(0), m_timeWindow(false),
+	m_statistics(StatMean), m_reduction(ReduceAverage), m_deviation(0.0),
+	m_alignPeriods(false), m_statisticsInterval(0), m_workers(1),
+	m_pretriggerMemory(0), m_debounce(1), m_minimumDuration(0), m_holdOff(0),
+	m_retrigger(false), m_triggerExpression(0), m_untriggerExpression(0),
+	m_compiles(0)
 {
-	setTrigger(config.getValue("trigger"));
-	setUntrigger(config.getValue("untrigger"));
+	m_trigger = config.getValue("trigger");
+	m_untrigger = config.getValue("untrigger");
 	m_pretrigger = strtol(config.getValue("preTrigger").c_str(), NULL, 10);
+	long memoryKb = strtol(config.getValue("pretriggerMemory").c_str(), NULL, 10);
+	if (memoryKb > 0)
+	{
+		m_pretriggerMemory = memoryKb * 1024;
+	}
 	string condition = config.getValue("condition");
 	if (condition.compare("Expression") == 0)
 	{
@@ -500,37 +1734,62 @@ void RateFilter::handleConfig(const ConfigCategory& config)
 		m_timeWindow = true;
 	}
 	long windowMs = strtol(config.getValue("time").c_str(), NULL, 10);
-	m_fullTime.tv_sec = windowMs / 1000;
-	m_fullTime.tv_usec = (windowMs % 1000) * 1000;
+	m_fullTime = windowMs * NS_PER_MS;
 
-	int rate = strtol(config.getValue("rate").c_str(), NULL, 10);
+	// The reduced rate is held as the length of the period in nanoseconds
+	long rate = strtol(config.getValue("rate").c_str(), NULL, 10);
 	string unit = config.getValue("rateUnit");
-	if (rate == 0)
+	if (rate <= 0)
 	{
-		m_rate.tv_sec = 0;
-		m_rate.tv_usec = 0;
+		m_rate = 0;
 	}
 	else if (unit.compare("per second") == 0)
 	{
-		m_rate.tv_sec = 0;
-		m_rate.tv_usec = 1000000 / rate;
+		m_rate = NS_PER_SECOND / rate;
 	}
 	else if (unit.compare("per minute") == 0)
 	{
-		m_rate.tv_sec = 60 / rate;
-		m_rate.tv_usec = 0;
+		m_rate = 60 * NS_PER_SECOND / rate;
 	}
 	else if (unit.compare("per hour") == 0)
 	{
-		m_rate.tv_sec = 3600 / rate;
-		m_rate.tv_usec = 0;
+		m_rate = 3600 * NS_PER_SECOND / rate;
 	}
 	else if (unit.compare("per day") == 0)
 	{
-		m_rate.tv_sec = (24 * 60 * 60) / rate;
-		m_rate.tv_usec = 0;
+		m_rate = 24 * 3600 * NS_PER_SECOND / rate;
+	}
+	m_alignPeriods = config.getValue("alignPeriods").compare("true") == 0;
+	parseStatistics(config.getValue("statistics"));
+
+	string reduction = config.getValue("reduction");
+	if (reduction.compare("Min/Max") == 0)
+	{
+		m_reduction = ReduceMinMax;
+	}
+	else if (reduction.compare("LTTB") == 0)
+	{
+		m_reduction = ReduceLTTB;
+	}
+	else if (reduction.compare("Deadband") == 0)
+	{
+		m_reduction = ReduceDeadband;
 	}
+	else if (reduction.compare("Swinging Door") == 0)
+	{
+		m_reduction = ReduceSwingingDoor;
+	}
+	m_reductionDatapoint = config.getValue("reductionDatapoint");
+	m_deviation = fabs(strtod(config.getValue("deviation").c_str(), NULL));
+	long interval = strtol(config.getValue("statisticsInterval").c_str(), NULL, 10);
+	if (interval > 0)
+	{
+		m_statisticsInterval = interval * NS_PER_SECOND;
+	}
+	m_statisticsAsset = config.getValue("statisticsAsset");
+
 	string exclusions = config.getValue("exclusions");
+	m_exclusions.clear();
 	rapidjson::Document doc;
 	doc.Parse(exclusions.c_str());
 	if (!doc.HasParseError())
@@ -543,7 +1802,7 @@ void RateFilter::handleConfig(const ConfigCategory& config)
                         {
 				if (itr->IsString())
 				{
-					m_exclusions.push_back(itr->GetString());
+					m_exclusions.intern(itr->GetString());
 				}
 				else
 				{
@@ -561,23 +1820,154 @@ void RateFilter::handleConfig(const ConfigCategory& config)
 	{
 		Logger::getLogger()->error("Error parsing the exlcusions element. The exclusions element should be an array of strings");
 	}
+
+	// There is no gain in more workers than the processors that run them
+	m_workers = 1;
+	long workers = strtol(config.getValue("workers").c_str(), NULL, 10);
+	unsigned int processors = thread::hardware_concurrency();
+	if (processors > 0 && workers > processors)
+	{
+		workers = processors;
+	}
+	if (workers > 1)
+	{
+		m_workers = workers;
+	}
+
+	long debounce = strtol(config.getValue("debounce").c_str(), NULL, 10);
+	if (debounce > 1)
+	{
+		m_debounce = debounce;
+	}
+	long minimumMs = strtol(config.getValue("minimumDuration").c_str(), NULL, 10);
+	if (minimumMs > 0)
+	{
+		m_minimumDuration = minimumMs * NS_PER_MS;
+	}
+	long holdOffMs = strtol(config.getValue("holdOff").c_str(), NULL, 10);
+	if (holdOffMs > 0)
+	{
+		m_holdOff = holdOffMs * NS_PER_MS;
+	}
+	m_retrigger = config.getValue("retrigger").compare("true") == 0;
+
+	compile(m_triggerExpression, m_untriggerExpression);
+	if (m_workers > 1 && !m_triggerExpression->isQualified()
+		&& !m_untriggerExpression->isQualified())
+	{
+		m_workerTriggers.resize(m_workers - 1);
+		m_workerUntriggers.resize(m_workers - 1);
+		for (unsigned int i = 0; i < m_workers - 1; i++)
+		{
+			compile(m_workerTriggers[i], m_workerUntriggers[i]);
+		}
+	}
 }
 
+/**
+ * Compile the trigger and untrigger expressions of the configuration,
+ * counting the compilations
+ *
+ * @param trigger	Set to the trigger expression
+ * @param untrigger	Set to the untrigger expression
+ */
+void RateFilter::Config::compile(Evaluator *& trigger, Evaluator *& untrigger)
+{
+	m_compiles += 2;
+	trigger = new Evaluator(m_trigger);
+	if (!m_untrigger.empty())
+	{
+		untrigger = new Evaluator(m_untrigger);
+	}
+	else
+	{
+		// With no untrigger expression the trigger returning to false ends the trigger
+		untrigger = new Evaluator(string("!(") + m_trigger + string(")"));
+	}
+}
 
 /**
- * Check if the asset name is in the exclusions list
+ * Parse the set of statistics to send in the reduced rate readings. If
+ * no statistics are given the mean is sent.
  *
- * @param name	The asset name to check
- * @return true if the asset is exempt from the rate limiting
+ * @param json	The statistics configuration item
  */
-bool RateFilter::isExcluded(const string& asset)
+void RateFilter::Config::parseStatistics(const string& json)
 {
-	for (auto it = m_exclusions.cbegin(); it != m_exclusions.cend(); ++it)
+	static const struct {
+		const char	*name;
+		Statistic	statistic;
+	} names[] = {
+		{ "mean", StatMean },
+		{ "min", StatMin },
+		{ "max", StatMax },
+		{ "first", StatFirst },
+		{ "last", StatLast },
+		{ "count", StatCount },
+		{ "variance", StatVariance },
+		{ "stddev", StatStddev }
+	};
+
+	m_statistics = 0;
+	rapidjson::Document doc;
+	doc.Parse(json.c_str());
+	if (!doc.HasParseError() && doc.IsObject() && doc.HasMember("statistics")
+			&& doc["statistics"].IsArray())
 	{
-		if (asset.compare(*it) == 0)
+		const rapidjson::Value& values = doc["statistics"];
+		for (rapidjson::Value::ConstValueIterator itr = values.Begin();
+						itr != values.End(); ++itr)
 		{
-			return true;
+			unsigned int statistic = 0;
+			if (itr->IsString())
+			{
+				for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+				{
+					if (strcmp(itr->GetString(), names[i].name) == 0)
+					{
+						statistic = names[i].statistic;
+					}
+				}
+			}
+			if (statistic == 0)
+			{
+				Logger::getLogger()->error("The statistics element should be an array containing mean, min, max, first, last, count, variance or stddev");
+			}
+			m_statistics |= statistic;
 		}
 	}
-	return false;
+	else if (!json.empty())
+	{
+		Logger::getLogger()->error("The statistics element should be an array of strings");
+	}
+	if (m_statistics == 0)
+	{
+		m_statistics = StatMean;
+	}
+}
+
+/**
+ * Destroy a configuration snapshot and the evaluators it owns
+ */
+RateFilter::Config::~Config()
+{
+	delete m_triggerExpression;
+	delete m_untriggerExpression;
+	for (size_t i = 0; i < m_workerTriggers.size(); i++)
+	{
+		delete m_workerTriggers[i];
+		delete m_workerUntriggers[i];
+	}
+}
+
+
+/**
+ * Check if the asset name is in the exclusions list
+ *
+ * @param name	The asset name to check
+ * @return true if the asset is exempt from the rate limiting
+ */
+bool RateFilter::Config::isExcluded(const string& asset) const
+{
+	return m_exclusions.find(asset) != INTERN_NOT_FOUND;
 }
@@ -0,0 +1,614 @@
+/*
+ * FogLAMP "rate" filter plugin.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <reducer.h>
+#include <math.h>
+
+using namespace std;
+
+/**
+ * Find the value of a reading used by the reducer, either the named
+ * datapoint or the first numeric datapoint of the reading.
+ *
+ * @param reading	The reading
+ * @param value		The value of the datapoint
+ * @return		False if the reading has no such datapoint
+ */
+bool Reducer::value(Reading *reading, double& value) const
+{
+	const vector<Datapoint *>& datapoints = reading->getReadingData();
+	for (auto it = datapoints.cbegin(); it != datapoints.cend(); ++it)
+	{
+		if (!m_datapoint.empty() && (*it)->getName().compare(m_datapoint) != 0)
+		{
+			continue;
+		}
+		DatapointValue& dpvalue = (*it)->getData();
+		if (dpvalue.getType() == DatapointValue::T_INTEGER)
+		{
+			value = dpvalue.toInt();
+			return true;
+		}
+		if (dpvalue.getType() == DatapointValue::T_FLOAT)
+		{
+			value = dpvalue.toDouble();
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Construct a reducer that sends the minimum and maximum readings
+ *
+ * @param datapoint	The datapoint used to select readings
+ */
+MinMaxReducer::MinMaxReducer(const string& datapoint) : Reducer(datapoint),
+	m_min(NULL), m_max(NULL), m_minValue(0.0), m_maxValue(0.0),
+	m_minTime(0), m_maxTime(0)
+{
+}
+
+/**
+ * Destroy the reducer and any readings it holds
+ */
+MinMaxReducer::~MinMaxReducer()
+{
+	vector<Reading *> unused;
+	clear(unused);
+}
+
+/**
+ * Offer a reading to the reducer
+ *
+ * @param reading	The reading
+ * @param tm		The user timestamp of the reading
+ * @param out		The output readings, unused
+ * @return		True if the reducer has taken ownership of the reading
+ */
+bool MinMaxReducer::add(Reading *reading, Timestamp tm, vector<Reading *>& out)
+{
+	double value;
+	if (!Reducer::value(reading, value))
+	{
+		return false;
+	}
+	if (m_min == NULL)
+	{
+		m_min = m_max = reading;
+		m_minValue = m_maxValue = value;
+		m_minTime = m_maxTime = tm;
+		return true;
+	}
+	if (value < m_minValue)
+	{
+		release(m_min, m_max);
+		m_min = reading;
+		m_minValue = value;
+		m_minTime = tm;
+		return true;
+	}
+	if (value > m_maxValue)
+	{
+		release(m_max, m_min);
+		m_max = reading;
+		m_maxValue = value;
+		m_maxTime = tm;
+		return true;
+	}
+	return false;
+}
+
+/**
+ * End the current period, sending the readings with the minimum and
+ * maximum values
+ *
+ * @param out	The output readings
+ */
+void MinMaxReducer::close(vector<Reading *>& out)
+{
+	if (m_min == NULL)
+	{
+		return;
+	}
+	if (m_min == m_max)
+	{
+		out.push_back(m_min);
+	}
+	else
+	{
+		if (m_maxTime < m_minTime)
+		{
+			out.push_back(m_max);
+			out.push_back(m_min);
+		}
+		else
+		{
+			out.push_back(m_min);
+			out.push_back(m_max);
+		}
+	}
+	m_min = m_max = NULL;
+}
+
+/**
+ * Discard the readings of the current period
+ *
+ * @param out	The output readings, unused
+ */
+void MinMaxReducer::clear(vector<Reading *>& out)
+{
+	release(m_min, m_max);
+	delete m_max;
+	m_min = m_max = NULL;
+}
+
+/**
+ * Delete a reading that is no longer a candidate, unless it is still
+ * held as the other candidate
+ *
+ * @param reading	The reading to release
+ * @param other		The other candidate
+ */
+void MinMaxReducer::release(Reading *reading, Reading *other)
+{
+	if (reading != other)
+	{
+		delete reading;
+	}
+}
+
+/**
+ * Construct a reducer that uses the Largest Triangle Three Buckets
+ * algorithm
+ *
+ * @param datapoint	The datapoint used to select readings
+ */
+LTTBReducer::LTTBReducer(const string& datapoint) : Reducer(datapoint),
+	m_anchored(false), m_anchorTime(0), m_anchorValue(0.0)
+{
+}
+
+/**
+ * Destroy the reducer and any readings it holds
+ */
+LTTBReducer::~LTTBReducer()
+{
+	m_current.clear();
+	m_previous.clear();
+}
+
+/**
+ * Offer a reading to the reducer. All readings of the current and
+ * previous periods are held by the reducer.
+ *
+ * @param reading	The reading
+ * @param tm		The user timestamp of the reading
+ * @param out		The output readings, unused
+ * @return		True if the reducer has taken ownership of the reading
+ */
+bool LTTBReducer::add(Reading *reading, Timestamp tm, vector<Reading *>& out)
+{
+	double value;
+	if (!Reducer::value(reading, value))
+	{
+		return false;
+	}
+	m_current.m_readings.push_back(reading);
+	m_current.m_times.push_back(tm);
+	m_current.m_values.push_back(value);
+	return true;
+}
+
+/**
+ * End the current period. The reading to send for the previous period
+ * is chosen using the mean of the current period as the third point of
+ * the triangle. The mean time is taken from the offsets of the times
+ * from the first of the period, a sum of the times themselves would
+ * overflow.
+ *
+ * @param out	The output readings
+ */
+void LTTBReducer::close(vector<Reading *>& out)
+{
+	if (m_current.m_readings.empty())
+	{
+		return;
+	}
+	Timestamp first = m_current.m_times[0];
+	double offset = 0.0, value = 0.0;
+	for (size_t i = 0; i < m_current.m_times.size(); i++)
+	{
+		offset += m_current.m_times[i] - first;
+		value += m_current.m_values[i];
+	}
+	Timestamp time = first + (Timestamp)(offset / m_current.m_times.size());
+	select(time, value / m_current.m_values.size(), out);
+	swap(m_previous, m_current);
+}
+
+/**
+ * The readings are about to be sent at full rate, send the reading for
+ * the previous period using its last reading as the third point and
+ * discard the current period.
+ *
+ * @param out	The output readings
+ */
+void LTTBReducer::clear(vector<Reading *>& out)
+{
+	if (!m_previous.m_readings.empty())
+	{
+		select(m_previous.m_times.back(), m_previous.m_values.back(), out);
+	}
+	m_current.clear();
+	m_anchored = false;
+}
+
+/**
+ * Send the reading of the previous period that forms the largest triangle
+ * with the last reading sent and the point given, and discard the other
+ * readings of the previous period. If no reading has been sent the first
+ * reading of the period is sent.
+ *
+ * The times are taken relative to the last reading sent, the differences
+ * of the integer times are exact.
+ *
+ * @param time	The time of the third point
+ * @param value	The value of the third point
+ * @param out	The output readings
+ */
+void LTTBReducer::select(Timestamp time, double value, vector<Reading *>& out)
+{
+	size_t count = m_previous.m_readings.size();
+	if (count == 0)
+	{
+		return;
+	}
+	size_t selected = 0;
+	if (m_anchored)
+	{
+		const Timestamp *times = m_previous.m_times.data();
+		const double *values = m_previous.m_values.data();
+		double third = (double)(m_anchorTime - time);
+		double largest = -1.0;
+		for (size_t i = 0; i < count; i++)
+		{
+			double area = fabs(third * (values[i] - m_anchorValue)
+					- (double)(m_anchorTime - times[i]) * (value - m_anchorValue));
+			if (area > largest)
+			{
+				largest = area;
+				selected = i;
+			}
+		}
+	}
+	out.push_back(m_previous.m_readings[selected]);
+	m_previous.m_readings[selected] = NULL;
+	m_anchorTime = m_previous.m_times[selected];
+	m_anchorValue = m_previous.m_values[selected];
+	m_anchored = true;
+	m_previous.clear();
+}
+
+/**
+ * Delete the readings held in a bucket and empty it
+ */
+void LTTBReducer::Bucket::clear()
+{
+	for (auto it = m_readings.begin(); it != m_readings.end(); ++it)
+	{
+		delete *it;
+	}
+	m_readings.clear();
+	m_times.clear();
+	m_values.clear();
+}
+
+/**
+ * Construct the base of a compression reducer
+ *
+ * @param datapoint	The datapoint to monitor, or empty for all
+ * @param deviation	The deviation allowed before a reading is sent
+ */
+CompressionReducer::CompressionReducer(const string& datapoint, double deviation) :
+	Reducer(datapoint), m_deviation(deviation), m_started(false),
+	m_sent(false), m_held(NULL), m_heldTime(0)
+{
+}
+
+/**
+ * Destroy the reducer and any reading it holds
+ */
+CompressionReducer::~CompressionReducer()
+{
+	delete m_held;
+}
+
+/**
+ * End the current period. If no reading was sent during the period
+ * then send the latest reading.
+ *
+ * @param out	The output readings
+ */
+void CompressionReducer::close(vector<Reading *>& out)
+{
+	if (!m_sent && m_held)
+	{
+		Reading *reading = m_held;
+		m_held = NULL;
+		points(reading, m_points);
+		archive(m_heldTime, m_points);
+		out.push_back(reading);
+	}
+	m_sent = false;
+}
+
+/**
+ * The readings are about to be sent at full rate. Discard the held
+ * reading, the first reading offered after this is always sent.
+ *
+ * @param out	The output readings, unused
+ */
+void CompressionReducer::clear(vector<Reading *>& out)
+{
+	delete m_held;
+	m_held = NULL;
+	m_started = false;
+	m_sent = false;
+}
+
+/**
+ * Collect the values of the monitored datapoints of a reading
+ *
+ * @param reading	The reading
+ * @param points	The values of the monitored datapoints
+ * @return		True if a datapoint has not been seen before
+ */
+bool CompressionReducer::points(Reading *reading, vector<Point>& points)
+{
+	bool added = false;
+	points.clear();
+	const vector<Datapoint *>& datapoints = reading->getReadingData();
+	for (auto it = datapoints.cbegin(); it != datapoints.cend(); ++it)
+	{
+		if (!m_datapoint.empty() && (*it)->getName().compare(m_datapoint) != 0)
+		{
+			continue;
+		}
+		Point point;
+		DatapointValue& dpvalue = (*it)->getData();
+		if (dpvalue.getType() == DatapointValue::T_INTEGER)
+		{
+			point.value = dpvalue.toInt();
+		}
+		else if (dpvalue.getType() == DatapointValue::T_FLOAT)
+		{
+			point.value = dpvalue.toDouble();
+		}
+		else
+		{
+			continue;
+		}
+		unsigned int count = m_names.size();
+		point.id = m_names.intern((*it)->getName());
+		if (point.id == count)
+		{
+			added = true;
+		}
+		points.push_back(point);
+	}
+	return added;
+}
+
+/**
+ * Send a reading, discarding any held reading
+ *
+ * @param reading	The reading to send
+ * @param out		The output readings
+ */
+void CompressionReducer::send(Reading *reading, vector<Reading *>& out)
+{
+	if (m_held != reading)
+	{
+		delete m_held;
+	}
+	m_held = NULL;
+	out.push_back(reading);
+	m_started = true;
+	m_sent = true;
+}
+
+/**
+ * Hold a reading as the latest reading, discarding any previously
+ * held reading
+ *
+ * @param reading	The reading to hold
+ * @param tm		The user timestamp of the reading
+ */
+void CompressionReducer::hold(Reading *reading, Timestamp tm)
+{
+	delete m_held;
+	m_held = reading;
+	m_heldTime = tm;
+}
+
+/**
+ * Construct a deadband reducer
+ *
+ * @param datapoint	The datapoint to monitor, or empty for all
+ * @param deviation	The width of the deadband either side of the last value sent
+ */
+DeadbandReducer::DeadbandReducer(const string& datapoint, double deviation) :
+	CompressionReducer(datapoint, deviation)
+{
+}
+
+/**
+ * Offer a reading to the reducer. The reading is sent if a datapoint
+ * has left the deadband, otherwise it is held as the latest reading.
+ *
+ * @param reading	The reading
+ * @param tm		The user timestamp of the reading
+ * @param out		The output readings
+ * @return		True as the reducer always takes ownership
+ */
+bool DeadbandReducer::add(Reading *reading, Timestamp tm, vector<Reading *>& out)
+{
+	bool changed = points(reading, m_points) || !m_started;
+	for (auto it = m_points.cbegin(); !changed && it != m_points.cend(); ++it)
+	{
+		if (fabs(it->value - m_last[it->id]) > m_deviation)
+		{
+			changed = true;
+		}
+	}
+	if (changed)
+	{
+		archive(tm, m_points);
+		send(reading, out);
+	}
+	else
+	{
+		hold(reading, tm);
+	}
+	return true;
+}
+
+/**
+ * Record the values of a reading that has been sent
+ *
+ * @param time		The time of the reading, unused
+ * @param points	The values of the monitored datapoints
+ */
+void DeadbandReducer::archive(Timestamp time, const vector<Point>& points)
+{
+	m_last.resize(m_names.size());
+	for (auto it = points.cbegin(); it != points.cend(); ++it)
+	{
+		m_last[it->id] = it->value;
+	}
+}
+
+/**
+ * Construct a swinging door reducer
+ *
+ * @param datapoint	The datapoint to monitor, or empty for all
+ * @param deviation	The compression deviation
+ */
+SwingingDoorReducer::SwingingDoorReducer(const string& datapoint, double deviation) :
+	CompressionReducer(datapoint, deviation)
+{
+}
+
+/**
+ * Offer a reading to the reducer. The doors of each datapoint are
+ * narrowed by the reading, if the doors of any datapoint close then
+ * the held reading is sent and the doors are opened again from it.
+ *
+ * The slopes of the doors are per second, the elapsed times are taken
+ * as differences of the integer times so no precision is lost.
+ *
+ * @param reading	The reading
+ * @param time		The user timestamp of the reading
+ * @param out		The output readings
+ * @return		True as the reducer always takes ownership
+ */
+bool SwingingDoorReducer::add(Reading *reading, Timestamp time, vector<Reading *>& out)
+{
+	if (points(reading, m_points) || !m_started)
+	{
+		archive(time, m_points);
+		send(reading, out);
+		return true;
+	}
+
+	bool closed = false;
+	for (auto it = m_points.cbegin(); it != m_points.cend(); ++it)
+	{
+		if (time <= m_archiveTimes[it->id])
+		{
+			closed |= fabs(it->value - m_archiveValues[it->id]) > m_deviation;
+			continue;
+		}
+		double elapsed = (double)(time - m_archiveTimes[it->id]) / NS_PER_SECOND;
+		double upper = (it->value + m_deviation - m_archiveValues[it->id]) / elapsed;
+		double lower = (it->value - m_deviation - m_archiveValues[it->id]) / elapsed;
+		if (upper < m_upper[it->id])
+		{
+			m_upper[it->id] = upper;
+		}
+		if (lower > m_lower[it->id])
+		{
+			m_lower[it->id] = lower;
+		}
+		closed |= m_lower[it->id] > m_upper[it->id];
+	}
+	if (closed)
+	{
+		if (m_held)
+		{
+			// Send the held reading and open the doors from it to this reading
+			archive(m_heldTime, m_heldPoints);
+			send(m_held, out);
+			for (auto it = m_points.cbegin(); it != m_points.cend(); ++it)
+			{
+				open(it->id, time, it->value);
+			}
+		}
+		else
+		{
+			archive(time, m_points);
+			send(reading, out);
+			return true;
+		}
+	}
+	hold(reading, time);
+	m_heldPoints = m_points;
+	return true;
+}
+
+/**
+ * Make a reading the archived reading from which the doors open
+ *
+ * @param time		The time of the reading
+ * @param points	The values of the monitored datapoints
+ */
+void SwingingDoorReducer::archive(Timestamp time, const vector<Point>& points)
+{
+	unsigned int size = m_names.size();
+	m_archiveTimes.resize(size);
+	m_archiveValues.resize(size);
+	m_upper.resize(size);
+	m_lower.resize(size);
+	for (auto it = points.cbegin(); it != points.cend(); ++it)
+	{
+		m_archiveTimes[it->id] = time;
+		m_archiveValues[it->id] = it->value;
+		m_upper[it->id] = HUGE_VAL;
+		m_lower[it->id] = -HUGE_VAL;
+	}
+}
+
+/**
+ * Narrow the doors of a datapoint, newly opened from the archived
+ * reading, to include a reading
+ *
+ * @param id	The datapoint
+ * @param time	The time of the reading
+ * @param value	The value of the datapoint
+ */
+void SwingingDoorReducer::open(unsigned int id, Timestamp time, double value)
+{
+	if (time > m_archiveTimes[id])
+	{
+		double elapsed = (double)(time - m_archiveTimes[id]) / NS_PER_SECOND;
+		m_upper[id] = (value + m_deviation - m_archiveValues[id]) / elapsed;
+		m_lower[id] = (value - m_deviation - m_archiveValues[id]) / elapsed;
+	}
+}
@@ -0,0 +1,239 @@
+/*
+ * FogLAMP "rate" filter plugin.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <spill_file.h>
+#include <logger.h>
+#include <string>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+using namespace std;
+
+#define INITIAL_SIZE	(1024 * 1024)		// Initial size of the file
+#define HEADER_SIZE	sizeof(uint64_t)	// The length that precedes each record
+
+/**
+ * Round a record length up so that records stay 8 byte aligned
+ */
+static size_t recordSize(size_t length)
+{
+	return HEADER_SIZE + ((length + 7) & ~(size_t)7);
+}
+
+/**
+ * Construct an empty spill file, the file is created when the first
+ * record is added.
+ */
+SpillFile::SpillFile() : m_fd(-1), m_base(NULL), m_size(0), m_head(0),
+	m_tail(0), m_end(0), m_wrapped(false), m_count(0), m_failed(false)
+{
+}
+
+/**
+ * Unmap and close the file, the file is removed by the close
+ */
+SpillFile::~SpillFile()
+{
+	if (m_base)
+	{
+		munmap(m_base, m_size);
+	}
+	if (m_fd != -1)
+	{
+		close(m_fd);
+	}
+}
+
+/**
+ * Create the file in the FogLAMP data directory, or in /tmp if there is
+ * no FogLAMP data directory, and map it into memory.
+ *
+ * @return	False if the file could not be created
+ */
+bool SpillFile::create()
+{
+	string directory;
+	if (getenv("FOGLAMP_DATA"))
+	{
+		directory = getenv("FOGLAMP_DATA");
+	}
+	else if (getenv("FOGLAMP_ROOT"))
+	{
+		directory = string(getenv("FOGLAMP_ROOT")) + "/data";
+	}
+	else
+	{
+		directory = "/tmp";
+	}
+	string path = directory + "/rate_pretrigger_XXXXXX";
+	m_fd = mkstemp(&path[0]);
+	if (m_fd == -1)
+	{
+		Logger::getLogger()->error("Unable to create the pretrigger spill file %s: %s",
+				path.c_str(), strerror(errno));
+		return false;
+	}
+	unlink(path.c_str());
+	if (ftruncate(m_fd, INITIAL_SIZE) == -1)
+	{
+		Logger::getLogger()->error("Unable to size the pretrigger spill file: %s",
+				strerror(errno));
+		return false;
+	}
+	void *base = mmap(NULL, INITIAL_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+	if (base == MAP_FAILED)
+	{
+		Logger::getLogger()->error("Unable to map the pretrigger spill file: %s",
+				strerror(errno));
+		return false;
+	}
+	m_base = (char *)base;
+	m_size = INITIAL_SIZE;
+	return true;
+}
+
+/**
+ * Double the size of the file. If the records wrap around the end of the
+ * file the records at the start of the file are moved to follow those at
+ * the end, so that the records are no longer wrapped.
+ *
+ * @return	False if the file could not be grown
+ */
+bool SpillFile::grow()
+{
+	size_t size = m_size * 2;
+	if (ftruncate(m_fd, size) == -1)
+	{
+		Logger::getLogger()->error("Unable to grow the pretrigger spill file: %s",
+				strerror(errno));
+		return false;
+	}
+	void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+	if (base == MAP_FAILED)
+	{
+		Logger::getLogger()->error("Unable to map the pretrigger spill file: %s",
+				strerror(errno));
+		return false;
+	}
+	munmap(m_base, m_size);
+	m_base = (char *)base;
+	m_size = size;
+	if (m_wrapped)
+	{
+		memcpy(m_base + m_end, m_base, m_tail);
+		m_tail += m_end;
+		m_wrapped = false;
+	}
+	return true;
+}
+
+/**
+ * Add a record to the back of the ring. Once the file could not be
+ * created or grown no more records are added.
+ *
+ * @param length	The length of the record
+ * @return		The storage for the record or NULL if the file
+ *			could not be created or grown
+ */
+void *SpillFile::append(size_t length)
+{
+	if (m_failed)
+	{
+		return NULL;
+	}
+	if (m_base == NULL && !create())
+	{
+		m_failed = true;
+		return NULL;
+	}
+	size_t size = recordSize(length);
+	for (;;)
+	{
+		if (!m_wrapped)
+		{
+			if (m_tail + size <= m_size)
+			{
+				break;
+			}
+			// Wrap to the start of the file if there is room before the front
+			if (size <= m_head)
+			{
+				m_end = m_tail;
+				m_tail = 0;
+				m_wrapped = true;
+				break;
+			}
+		}
+		else if (m_tail + size <= m_head)
+		{
+			break;
+		}
+		if (!grow())
+		{
+			m_failed = true;
+			return NULL;
+		}
+	}
+	char *record = m_base + m_tail;
+	*(uint64_t *)record = size;
+	m_tail += size;
+	m_count++;
+	return record + HEADER_SIZE;
+}
+
+/**
+ * Return the record at the front of the ring
+ *
+ * @return	The record or NULL if the ring is empty
+ */
+void *SpillFile::front() const
+{
+	if (m_count == 0)
+	{
+		return NULL;
+	}
+	return m_base + m_head + HEADER_SIZE;
+}
+
+/**
+ * Remove the record at the front of the ring
+ */
+void SpillFile::pop()
+{
+	if (m_count == 0)
+	{
+		return;
+	}
+	m_head += *(uint64_t *)(m_base + m_head);
+	if (--m_count == 0)
+	{
+		reset();
+	}
+	else if (m_wrapped && m_head == m_end)
+	{
+		m_head = 0;
+		m_wrapped = false;
+	}
+}
+
+/**
+ * Remove all of the records
+ */
+void SpillFile::reset()
+{
+	m_head = 0;
+	m_tail = 0;
+	m_end = 0;
+	m_wrapped = false;
+	m_count = 0;
+}
@@ -0,0 +1,356 @@
+/*
+ * FogLAMP "rate" filter plugin.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <threshold_predicate.h>
+#include <exprtk.hpp>
+#include <ctype.h>
+#include <string.h>
+#include <strings.h>
+
+using namespace std;
+
+/**
+ * Names that exprtk treats as keywords or constants rather than variables
+ */
+static const char *reserved[] = {
+	"and", "or", "not", "nand", "nor", "xor", "xnor", "mand", "mor",
+	"true", "false", "if", "else", "for", "while", "repeat", "until",
+	"switch", "case", "default", "break", "continue", "return", "var",
+	"in", "like", "ilike", "null", "pi", "epsilon", "inf", NULL
+};
+
+/**
+ * Skip any white space in the expression
+ *
+ * @param expression	The expression
+ * @param pos		The current position, updated past the white space
+ */
+static void skipSpace(const string& expression, size_t& pos)
+{
+	while (pos < expression.length() && isspace((unsigned char)expression[pos]))
+	{
+		pos++;
+	}
+}
+
+/**
+ * Check if a character may appear in a variable name
+ */
+static bool isSymbolChar(char c)
+{
+	return isalnum((unsigned char)c) || c == '_' || c == '.';
+}
+
+/**
+ * Read a variable name from the expression
+ *
+ * @param expression	The expression
+ * @param pos		The current position, updated past the name
+ * @param name		The name that was read
+ * @return		True if a name was read
+ */
+static bool readName(const string& expression, size_t& pos, string& name)
+{
+	skipSpace(expression, pos);
+	if (pos == expression.length() ||
+		!(isalpha((unsigned char)expression[pos]) || expression[pos] == '_'))
+	{
+		return false;
+	}
+	size_t start = pos;
+	while (pos < expression.length() && isSymbolChar(expression[pos]))
+	{
+		pos++;
+	}
+	name = expression.substr(start, pos - start);
+	return true;
+}
+
+/**
+ * Read a numeric constant from the expression. The value is obtained by
+ * having exprtk evaluate the text of the constant, so that the constant
+ * is exactly the value exprtk would have used.
+ *
+ * @param expression	The expression
+ * @param pos		The current position, updated past the constant
+ * @param value		The value of the constant
+ * @return		True if a constant was read
+ */
+static bool readNumber(const string& expression, size_t& pos, double& value)
+{
+	skipSpace(expression, pos);
+	size_t start = pos;
+	if (pos < expression.length() && (expression[pos] == '-' || expression[pos] == '+'))
+	{
+		pos++;
+	}
+	size_t digits = 0;
+	while (pos < expression.length() &&
+		(isdigit((unsigned char)expression[pos]) || expression[pos] == '.'))
+	{
+		if (expression[pos] != '.')
+		{
+			digits++;
+		}
+		pos++;
+	}
+	if (digits == 0)
+	{
+		return false;
+	}
+	if (pos < expression.length() && (expression[pos] == 'e' || expression[pos] == 'E'))
+	{
+		pos++;
+		if (pos < expression.length() && (expression[pos] == '-' || expression[pos] == '+'))
+		{
+			pos++;
+		}
+		while (pos < expression.length() && isdigit((unsigned char)expression[pos]))
+		{
+			pos++;
+		}
+	}
+	if (pos < expression.length() && isSymbolChar(expression[pos]))
+	{
+		return false;
+	}
+
+	exprtk::expression<double>	constant;
+	exprtk::parser<double>		parser;
+	if (!parser.compile(expression.substr(start, pos - start), constant))
+	{
+		return false;
+	}
+	value = constant.value();
+	return true;
+}
+
+/**
+ * Read an ordering comparison operator from the expression
+ *
+ * @param expression	The expression
+ * @param pos		The current position, updated past the operator
+ * @param op		The operator that was read
+ * @return		True if an ordering operator was read
+ */
+static bool readOperator(const string& expression, size_t& pos, ThresholdPredicate::Operator& op)
+{
+	skipSpace(expression, pos);
+	if (pos == expression.length())
+	{
+		return false;
+	}
+	bool equal = pos + 1 < expression.length() && expression[pos + 1] == '=';
+	switch (expression[pos])
+	{
+		case '<':
+			if (pos + 1 < expression.length() && expression[pos + 1] == '>')
+			{
+				return false;	// Not equal is left to exprtk
+			}
+			op = equal ? ThresholdPredicate::LessOrEqual : ThresholdPredicate::LessThan;
+			break;
+		case '>':
+			op = equal ? ThresholdPredicate::GreaterOrEqual : ThresholdPredicate::GreaterThan;
+			break;
+		default:
+			return false;
+	}
+	pos += equal ? 2 : 1;
+	return true;
+}
+
+/**
+ * Parse an expression and populate the terms of the predicate if the
+ * expression is a simple threshold expression.
+ *
+ * @param expression	The expression to parse
+ * @return		True if the expression can be evaluated natively
+ */
+bool ThresholdPredicate::parse(const string& expression)
+{
+	m_terms.clear();
+	size_t pos = 0;
+	for (;;)
+	{
+		if (!parseTerm(expression, pos))
+		{
+			m_terms.clear();
+			return false;
+		}
+		skipSpace(expression, pos);
+		if (pos == expression.length())
+		{
+			return true;
+		}
+		string conjunction;
+		if (!readName(expression, pos, conjunction) ||
+			strcasecmp(conjunction.c_str(), "and") != 0)
+		{
+			m_terms.clear();
+			return false;
+		}
+	}
+}
+
+/**
+ * Parse a single comparison, either the variable or the constant may
+ * be given first.
+ *
+ * @param expression	The expression being parsed
+ * @param pos		The current position, updated past the term
+ * @return		True if a comparison was parsed
+ */
+bool ThresholdPredicate::parseTerm(const string& expression, size_t& pos)
+{
+	Term term;
+	term.m_slot = -1;
+	size_t start = pos;
+	if (readName(expression, pos, term.m_variable))
+	{
+		if (!readOperator(expression, pos, term.m_operator) ||
+			!readNumber(expression, pos, term.m_value))
+		{
+			return false;
+		}
+	}
+	else
+	{
+		pos = start;
+		Operator op;
+		if (!readNumber(expression, pos, term.m_value) ||
+			!readOperator(expression, pos, op) ||
+			!readName(expression, pos, term.m_variable))
+		{
+			return false;
+		}
+		// Reverse the comparison so the variable is on the left
+		switch (op)
+		{
+			case LessThan:
+				term.m_operator = GreaterThan;
+				break;
+			case LessOrEqual:
+				term.m_operator = GreaterOrEqual;
+				break;
+			case GreaterThan:
+				term.m_operator = LessThan;
+				break;
+			case GreaterOrEqual:
+				term.m_operator = LessOrEqual;
+				break;
+		}
+	}
+	if (isReserved(term.m_variable))
+	{
+		return false;
+	}
+	m_terms.push_back(term);
+	return true;
+}
+
+/**
+ * Evaluate the predicate using the values in the bound variable slots
+ *
+ * @param variables	The variable slots
+ * @return		The result of the predicate
+ */
+bool ThresholdPredicate::evaluate(const double *variables) const
+{
+	for (auto it = m_terms.cbegin(); it != m_terms.cend(); ++it)
+	{
+		double value = variables[it->m_slot];
+		bool result;
+		switch (it->m_operator)
+		{
+			case LessThan:
+				result = value < it->m_value;
+				break;
+			case LessOrEqual:
+				result = value <= it->m_value;
+				break;
+			case GreaterThan:
+				result = value > it->m_value;
+				break;
+			default:
+				result = value >= it->m_value;
+				break;
+		}
+		if (!result)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Evaluate the predicate for a number of rows of variable values held
+ * in columns. The loops over the columns are kept simple so that the
+ * compiler is able to vectorise them.
+ *
+ * @param columns	The column of values for each term of the predicate
+ * @param rows		The number of rows to evaluate
+ * @param results	The result for each row, non-zero if the predicate is true
+ */
+void ThresholdPredicate::evaluate(const double * const *columns, size_t rows,
+				  unsigned char *results) const
+{
+	memset(results, 1, rows);
+	for (size_t term = 0; term < m_terms.size(); term++)
+	{
+		const double *values = columns[term];
+		const double threshold = m_terms[term].m_value;
+		switch (m_terms[term].m_operator)
+		{
+			case LessThan:
+				for (size_t i = 0; i < rows; i++)
+				{
+					results[i] &= values[i] < threshold;
+				}
+				break;
+			case LessOrEqual:
+				for (size_t i = 0; i < rows; i++)
+				{
+					results[i] &= values[i] <= threshold;
+				}
+				break;
+			case GreaterThan:
+				for (size_t i = 0; i < rows; i++)
+				{
+					results[i] &= values[i] > threshold;
+				}
+				break;
+			case GreaterOrEqual:
+				for (size_t i = 0; i < rows; i++)
+				{
+					results[i] &= values[i] >= threshold;
+				}
+				break;
+		}
+	}
+}
+
+/**
+ * Check if a name is one that exprtk does not treat as a variable
+ *
+ * @param name	The name to check
+ * @return	True if the name is reserved
+ */
+bool ThresholdPredicate::isReserved(const string& name)
+{
+	for (int i = 0; reserved[i]; i++)
+	{
+		if (strcasecmp(name.c_str(), reserved[i]) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,130 @@
+/*
+ * FogLAMP "rate" filter plugin.
+ *
+ * Copyright (c) 2026 Dianomic Systems
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <worker_pool.h>
+
+using namespace std;
+
+/**
+ * Construct a pool and start its threads
+ *
+ * @param threads	The number of threads in the pool
+ */
+WorkerPool::WorkerPool(unsigned int threads) : m_task(NULL), m_tasks(0),
+	m_next(0), m_pending(0), m_generation(0), m_shutdown(false)
+{
+	for (unsigned int i = 0; i < threads; i++)
+	{
+		m_threads.push_back(thread(&WorkerPool::worker, this));
+	}
+}
+
+/**
+ * Stop the threads of the pool and wait for them to exit
+ */
+WorkerPool::~WorkerPool()
+{
+	{
+		lock_guard<mutex> guard(m_mutex);
+		m_shutdown = true;
+	}
+	m_started.notify_all();
+	for (auto it = m_threads.begin(); it != m_threads.end(); ++it)
+	{
+		it->join();
+	}
+}
+
+/**
+ * Run a set of tasks, returning once all of them are done. The task is
+ * called once with each task number from 0 to tasks - 1.
+ *
+ * @param task	The task to run
+ * @param tasks	The number of tasks
+ */
+void WorkerPool::run(const function<void(unsigned int)>& task, unsigned int tasks)
+{
+	{
+		lock_guard<mutex> guard(m_mutex);
+		m_task = &task;
+		m_tasks = tasks;
+		m_next = 0;
+		m_pending = tasks;
+		m_generation++;
+	}
+	m_started.notify_all();
+
+	unsigned int number;
+	while (next(number))
+	{
+		task(number);
+		done();
+	}
+	unique_lock<mutex> lock(m_mutex);
+	m_finished.wait(lock, [this] { return m_pending == 0; });
+	m_task = NULL;
+}
+
+/**
+ * The body of a thread of the pool, waits for a set of tasks to be run
+ * and takes tasks from it until none remain.
+ */
+void WorkerPool::worker()
+{
+	unsigned long generation = 0;
+	for (;;)
+	{
+		{
+			unique_lock<mutex> lock(m_mutex);
+			m_started.wait(lock, [this, generation] {
+					return m_shutdown || m_generation != generation;
+				});
+			if (m_shutdown)
+			{
+				return;
+			}
+			generation = m_generation;
+		}
+		unsigned int number;
+		while (next(number))
+		{
+			(*m_task)(number);
+			done();
+		}
+	}
+}
+
+/**
+ * Take the next task of the current set
+ *
+ * @param task	Set to the number of the task taken
+ * @return	False if no task remains to be taken
+ */
+bool WorkerPool::next(unsigned int& task)
+{
+	lock_guard<mutex> guard(m_mutex);
+	if (m_next >= m_tasks)
+	{
+		return false;
+	}
+	task = m_next++;
+	return true;
+}
+
+/**
+ * Record that a task has finished
+ */
+void WorkerPool::done()
+{
+	lock_guard<mutex> guard(m_mutex);
+	if (--m_pending == 0)
+	{
+		m_finished.notify_all();
+	}
+}